@@ -28,6 +28,12 @@
 #include "utils.h"
 #include "bodypart.h"
 #include "connection.h"
+#include "server.h"
+#include "sharedbuffer.h"
+#include "sharedfile.h"
+
+#include <sys/mman.h>
+#include <sys/uio.h>
 
 // Creates a new body part
 SBodyPart::SBodyPart(int bType, unsigned index, void *d)
@@ -68,7 +74,7 @@ void SRawBodyPart::SetBody(const char *buffer, unsigned size)
 // Inserts into the body
 void SRawBodyPart::InsertInBody(const SString &data, size_t offset)
 {
-    InsertInBody(data.c_str(), data.size());
+    InsertInBody(data.c_str(), (unsigned)data.size(), offset);
 }
 
 // Inserts into the body
@@ -107,6 +113,16 @@ bool SRawBodyPart::WriteToConnection(SConnection *pConn, int &numWritten)
     return numWritten != length;
 }
 
+//! Writes the body with MSG_ZEROCOPY
+bool SRawBodyPart::WriteToConnectionZeroCopy(SConnection *pConn, int &numWritten, long long &sequence)
+{
+    int length = data.size() - bytesWritten;
+    numWritten = pConn->WriteDataZeroCopy(&data[bytesWritten], length, sequence);
+    if (numWritten > 0)
+        bytesWritten += numWritten;
+    return numWritten != length;
+}
+
 /************************************************************************
  *
  *                              File Body Parts
@@ -119,17 +135,76 @@ SFileBodyPart::SFileBodyPart(const SString &fname, size_t fsize,
     SBodyPart(BP_FILE, index, data),
     filename(fname),
     readFD(-1),
+    pSharedFile(NULL),
     filesize(fsize),
-    offset(0)
+    offset(0),
+    fileOffset(0),
+    rangeStart(0),
+    rangeEnd(fsize)
 {
 }
 
+//! Closes the file if it is still open
+SFileBodyPart::~SFileBodyPart()
+{
+    if (pSharedFile != NULL)
+        pSharedFile->DecRef();
+    else if (readFD >= 0)
+        close(readFD);
+}
+
+//! Sends from an already open file instead of opening filename
+void SFileBodyPart::SetSharedFile(SSharedFile *pFile, off_t start)
+{
+    assert("File must be shared before it is opened" && readFD < 0);
+    pFile->IncRef();
+    pSharedFile = pFile;
+    readFD      = pFile->FD();
+    fileOffset  = start;
+}
+
+//! Only sends length bytes of the file starting at start
+void SFileBodyPart::SetRange(off_t start, size_t length)
+{
+    assert("Range must be within the file" && start >= 0 && start + length <= filesize);
+    rangeStart  = start;
+    rangeEnd    = start + length;
+    offset      = start;
+}
+
 //! Writes body part to a stream
 int SFileBodyPart::WriteToStream(std::ostream &output, int from)
 {
-    return 0;
+    int fd = pSharedFile != NULL ? pSharedFile->FD() : open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        SLogger::Get()->Log("ERROR: Could not open file: %s, Error [%d]: %s\n",
+                            filename.c_str(), errno, strerror(errno));
+        return -1;
+    }
+
+    char    buffer[1 << 15];
+    off_t   readOffset  = rangeStart + from;
+    int     numWritten  = 0;
+    while (readOffset < rangeEnd)
+    {
+        size_t  toRead  = std::min((off_t)sizeof(buffer), rangeEnd - readOffset);
+        ssize_t numRead = pread(fd, buffer, toRead, fileOffset + readOffset);
+        if (numRead <= 0)
+            break ;
+        output.write(buffer, numRead);
+        readOffset  += numRead;
+        numWritten  += numRead;
+    }
+    if (pSharedFile == NULL)
+        close(fd);
+    return numWritten;
 }
 
+//! Most bytes asked of sendfile at a time, so the writer gets to check a
+// connection's write budget between calls
+static const int MAX_SENDFILE_LENGTH = 256 * 1024;
+
 //! Writes body part to a FD
 bool SFileBodyPart::WriteToConnection(SConnection *pConn, int &numWritten)
 {
@@ -143,16 +218,315 @@ bool SFileBodyPart::WriteToConnection(SConnection *pConn, int &numWritten)
         }
     }
 
-    int length = filesize - offset;
-    numWritten = sendfile(pConn->Socket(), readFD, &offset, length);
+    int     length      = std::min(rangeEnd - offset, (off_t)MAX_SENDFILE_LENGTH);
+    off_t   readOffset  = fileOffset + offset;
+    numWritten  = sendfile(pConn->Socket(), readFD, &readOffset, length);
+    offset      = readOffset - fileOffset;
+    if (numWritten == 0 && length > 0)
+    {
+        // the file got shorter after its size was sent out
+        SLogger::Get()->Log("ERROR: File shrank while being sent: %s\n", filename.c_str());
+        pConn->Server()->SetConnectionState(pConn, SConnection::STATE_CLOSED);
+        numWritten = -1;
+        return false;
+    }
 
-    if (numWritten == length)
+    if (offset >= rangeEnd)
     {
         // close the file if we are done with it
-        close(readFD);
+        if (pSharedFile == NULL)
+            close(readFD);
         readFD = -1;
+        return false;
     }
-    return numWritten != length;
+    return true;
+}
+
+/************************************************************************
+ *
+ *                              Segmented Body Parts
+ *
+ ***********************************************************************/
+//! Creates an empty segmented body part
+SSegmentedBodyPart::SSegmentedBodyPart(unsigned index, void *d)
+:
+    SBodyPart(BP_SEGMENTED, index, d),
+    dataSize(0),
+    bytesWritten(0),
+    droppable(false),
+    fileContents(false)
+{
+}
+
+//! Drops the references to the buffers
+SSegmentedBodyPart::~SSegmentedBodyPart()
+{
+    Clear();
+}
+
+//! Drops all the slices
+void SSegmentedBodyPart::Clear()
+{
+    for (std::deque<Slice>::iterator iter = slices.begin();iter != slices.end();++iter)
+        iter->pBuffer->DecRef();
+    slices.clear();
+    dataSize        = 0;
+    bytesWritten    = 0;
+}
+
+//! Makes a slice of a buffer (taking a reference to it)
+SSegmentedBodyPart::Slice SSegmentedBodyPart::MakeSlice(SSharedBuffer *pBuffer, size_t offset, size_t length)
+{
+    assert("Slice must be within the buffer" && offset <= pBuffer->Size());
+    if (length > pBuffer->Size() - offset)
+        length = pBuffer->Size() - offset;
+
+    pBuffer->IncRef();
+    Slice slice = { pBuffer, pBuffer->Data() + offset, length };
+    return slice;
+}
+
+//! Adds a slice of a buffer to the front
+void SSegmentedBodyPart::Prepend(SSharedBuffer *pBuffer, size_t offset, size_t length)
+{
+    assert("Cannot prepend once writing has started" && bytesWritten == 0);
+    slices.push_front(MakeSlice(pBuffer, offset, length));
+    dataSize += slices.front().length;
+}
+
+//! Adds a copy of some bytes to the front
+void SSegmentedBodyPart::Prepend(const char *buffer, size_t size)
+{
+    SSharedBuffer *pBuffer = SSharedBuffer::Create(buffer, size);
+    Prepend(pBuffer);
+    pBuffer->DecRef();
+}
+
+//! Adds a slice of a buffer to the end
+void SSegmentedBodyPart::Append(SSharedBuffer *pBuffer, size_t offset, size_t length)
+{
+    slices.push_back(MakeSlice(pBuffer, offset, length));
+    dataSize += slices.back().length;
+}
+
+//! Adds a copy of some bytes to the end
+void SSegmentedBodyPart::Append(const char *buffer, size_t size)
+{
+    SSharedBuffer *pBuffer = SSharedBuffer::Create(buffer, size);
+    Append(pBuffer);
+    pBuffer->DecRef();
+}
+
+//! Fills upto maxIov entries with the data from the given offset onwards
+int SSegmentedBodyPart::FillIOVec(struct iovec *iov, int maxIov, size_t from) const
+{
+    int numIov = 0;
+    for (std::deque<Slice>::const_iterator iter = slices.begin();
+            iter != slices.end() && numIov < maxIov;++iter)
+    {
+        if (from >= iter->length)
+        {
+            from -= iter->length;
+            continue ;
+        }
+        iov[numIov].iov_base    = const_cast<char *>(iter->pData + from);
+        iov[numIov].iov_len     = iter->length - from;
+        numIov++;
+        from = 0;
+    }
+    return numIov;
+}
+
+//! Writes body part to a stream
+int SSegmentedBodyPart::WriteToStream(std::ostream &output, int from)
+{
+    size_t skip = from;
+    for (std::deque<Slice>::iterator iter = slices.begin();iter != slices.end();++iter)
+    {
+        if (skip >= iter->length)
+        {
+            skip -= iter->length;
+            continue ;
+        }
+        output.write(iter->pData + skip, iter->length - skip);
+        skip = 0;
+    }
+    output.flush();
+    return dataSize - from;
+}
+
+//! Writes body part to a FD
+bool SSegmentedBodyPart::WriteToConnection(SConnection *pConn, int &numWritten)
+{
+    const int       MAX_IOV = 64;
+    struct iovec    iov[MAX_IOV];
+    int             numIov  = FillIOVec(iov, MAX_IOV, bytesWritten);
+
+    numWritten = numIov == 0 ? 0 : pConn->WriteData(iov, numIov);
+    if (numWritten > 0)
+        bytesWritten += numWritten;
+    return numWritten >= 0 && bytesWritten < dataSize;
+}
+
+/************************************************************************
+ *
+ *                              Spooled Body Parts
+ *
+ ***********************************************************************/
+//! Directory spool files are created in
+SString SSpooledBodyPart::spoolDir = "/tmp";
+
+//! Creates a new spooled body part
+SSpooledBodyPart::SSpooledBodyPart(size_t threshold, unsigned index, void *d)
+:
+    SBodyPart(BP_SPOOLED, index, d),
+    spoolThreshold(threshold),
+    dataSize(0),
+    spoolFD(-1),
+    pMapped(NULL),
+    offset(0)
+{
+}
+
+//! Destroys the body part and the spool file with it
+SSpooledBodyPart::~SSpooledBodyPart()
+{
+    Unmap();
+    if (spoolFD >= 0)
+        close(spoolFD);
+}
+
+//! Removes the mmap'ed view if any
+void SSpooledBodyPart::Unmap()
+{
+    if (pMapped != NULL)
+    {
+        munmap(pMapped, dataSize);
+        pMapped = NULL;
+    }
+}
+
+//! Moves the data into a new temporary file
+bool SSpooledBodyPart::SpoolToFile()
+{
+    SString path = spoolDir + "/halley-spool-XXXXXX";
+    SCharVector pathBuff(path.begin(), path.end());
+    pathBuff.push_back(0);
+
+    if ((spoolFD = mkstemp(&pathBuff[0])) < 0)
+    {
+        SLogger::Get()->Log("ERROR: Could not create spool file in %s, Error [%d]: %s\n",
+                            spoolDir.c_str(), errno, strerror(errno));
+        return false;
+    }
+
+    // the file goes away as soon as it is closed
+    unlink(&pathBuff[0]);
+
+    size_t inMemory = data.size();
+    dataSize = 0;
+    if (inMemory > 0 && !AppendToBody(&data[0], inMemory))
+        return false;
+
+    SCharVector().swap(data);
+    return true;
+}
+
+//! Appends raw bytes to the body, spooling to disk if necessary
+bool SSpooledBodyPart::AppendToBody(const char *buffer, size_t size)
+{
+    if (spoolFD < 0)
+    {
+        if ((size_t)dataSize + size <= spoolThreshold)
+        {
+            data.insert(data.end(), buffer, buffer + size);
+            dataSize += size;
+            return true;
+        }
+        else if (!SpoolToFile())
+        {
+            return false;
+        }
+    }
+
+    Unmap();
+    while (size > 0)
+    {
+        ssize_t numWritten = pwrite(spoolFD, buffer, size, dataSize);
+        if (numWritten < 0)
+        {
+            if (errno == EINTR)
+                continue ;
+            SLogger::Get()->Log("ERROR: Could not write to spool file, Error [%d]: %s\n",
+                                errno, strerror(errno));
+            return false;
+        }
+        buffer      += numWritten;
+        size        -= numWritten;
+        dataSize    += numWritten;
+    }
+    return true;
+}
+
+//! Returns a view of the whole body
+const char *SSpooledBodyPart::Data()
+{
+    if (dataSize == 0)
+        return NULL;
+    else if (spoolFD < 0)
+        return &data[0];
+
+    if (pMapped == NULL)
+    {
+        void *pAddr = mmap(NULL, dataSize, PROT_READ, MAP_PRIVATE, spoolFD, 0);
+        if (pAddr == MAP_FAILED)
+        {
+            SLogger::Get()->Log("ERROR: Could not mmap spool file, Error [%d]: %s\n",
+                                errno, strerror(errno));
+            return NULL;
+        }
+        pMapped = (char *)pAddr;
+    }
+    return pMapped;
+}
+
+//! Writes body part to a stream
+int SSpooledBodyPart::WriteToStream(std::ostream &output, int from)
+{
+    const char *pData = Data();
+    if (pData == NULL || from >= dataSize)
+        return 0;
+
+    output.write(pData + from, dataSize - from);
+    output.flush();
+    return dataSize - from;
+}
+
+//! Writes body part to a FD
+bool SSpooledBodyPart::WriteToConnection(SConnection *pConn, int &numWritten)
+{
+    // spooled bodies can be past 2GB so only the length of one write is
+    // ever narrowed to an int
+    off_t left = dataSize - offset;
+    if (left == 0)
+    {
+        numWritten = 0;
+        return false;
+    }
+
+    int length = std::min(left, (off_t)MAX_SENDFILE_LENGTH);
+    if (spoolFD < 0)
+    {
+        numWritten = pConn->WriteData(&data[offset], length);
+        if (numWritten > 0)
+            offset += numWritten;
+    }
+    else
+    {
+        // offset is advanced by sendfile
+        numWritten = sendfile(pConn->Socket(), spoolFD, &offset, length);
+    }
+    return offset < dataSize;
 }
 
 /************************************************************************
@@ -160,15 +534,126 @@ bool SFileBodyPart::WriteToConnection(SConnection *pConn, int &numWritten)
  *                              Lazy Body Parts
  *
  ***********************************************************************/
+//! Fewest bytes pulled at a time - a pull is made even if the socket
+// looks full so the write that follows can find out for sure
+static const size_t MIN_LAZY_PULL = 4096;
+
+//! Room left before pulled data for a chunk's size line (upto 8 hex
+// digits and a CRLF)
+static const size_t CHUNK_HEADER_SPACE = 10;
+
+//! Creates a new lazy body part
+SLazyBodyPart::SLazyBodyPart(SBodyProducer *pProd, unsigned index, void *d)
+:
+    SBodyPart(BP_LAZY, index, d),
+    pProducer(pProd),
+    pendingStart(0),
+    pendingEnd(0),
+    finished(false),
+    chunked(false),
+    maxPull(DEFAULT_MAX_PULL)
+{
+    assert("Lazy body parts need a producer" && pProducer != NULL);
+}
+
+//! Destroys the body part and its producer
+SLazyBodyPart::~SLazyBodyPart()
+{
+    delete pProducer;
+}
+
+//! Pulls upto maxBytes from the producer into the pending buffer
+bool SLazyBodyPart::Pull(size_t maxBytes)
+{
+    size_t headerSpace  = chunked ? CHUNK_HEADER_SPACE : 0;
+    size_t required     = headerSpace + maxBytes + (chunked ? 2 : 0);
+    if (pending.size() < required)
+        pending.resize(required);
+
+    pendingStart = pendingEnd = headerSpace;
+    int numProduced = pProducer->Produce(&pending[headerSpace], maxBytes);
+    if (numProduced < 0)
+    {
+        SLogger::Get()->Log("ERROR: Producer of lazy body part failed\n");
+        return false;
+    }
+    else if (numProduced == 0)
+    {
+        finished = true;
+        return true;
+    }
+
+    pendingEnd += numProduced;
+    if (chunked)
+    {
+        // the size line goes just before the data and the CRLF after it
+        char sizeLine[CHUNK_HEADER_SPACE + 1];
+        int lineLength = snprintf(sizeLine, sizeof(sizeLine), "%x\r\n", numProduced);
+        pendingStart = headerSpace - lineLength;
+        memcpy(&pending[pendingStart], sizeLine, lineLength);
+        pending[pendingEnd++] = '\r';
+        pending[pendingEnd++] = '\n';
+    }
+    return true;
+}
+
 //! Writes body part to a stream
 int SLazyBodyPart::WriteToStream(std::ostream &output, int from)
 {
-    return 0;
+    // the stream gets the bare data even if the part is chunked
+    bool wasChunked = chunked;
+    int  total      = 0;
+    chunked         = false;
+    while (true)
+    {
+        if (pendingStart == pendingEnd)
+        {
+            if (finished || !Pull(maxPull))
+                break ;
+            continue ;
+        }
+
+        size_t length   = pendingEnd - pendingStart;
+        size_t skipped  = std::min((size_t)from, length);
+        from            -= skipped;
+        length          -= skipped;
+        output.write(&pending[pendingStart + skipped], length);
+        total           += length;
+        pendingStart    = pendingEnd;
+    }
+    chunked = wasChunked;
+    output.flush();
+    return total;
 }
 
-//! Writes body part to a FD
+//! Writes body part to a FD - data is only pulled once the last pull has
+// been written out.  Returns true while there is more to write.
 bool SLazyBodyPart::WriteToConnection(SConnection *pConn, int &numWritten)
 {
-    return false;
+    numWritten = 0;
+    if (pendingStart == pendingEnd)
+    {
+        if (finished)
+            return false;
+
+        // ask for as much as the socket can take right now
+        int     room    = pConn->WritableBytes();
+        size_t  wanted  = room < 0 ? maxPull : std::min((size_t)room, maxPull);
+        if (!Pull(std::max(wanted, std::min(MIN_LAZY_PULL, maxPull))))
+        {
+            // the headers are out so all that can be done is to cut the
+            // response short
+            pConn->Server()->SetConnectionState(pConn, SConnection::STATE_CLOSED);
+            numWritten = -1;
+            return false;
+        }
+        if (pendingStart == pendingEnd)
+            return false;
+    }
+
+    numWritten = pConn->WriteData(&pending[pendingStart], pendingEnd - pendingStart);
+    if (numWritten > 0)
+        pendingStart += numWritten;
+    return numWritten >= 0;
 }
 
@@ -29,6 +29,9 @@
 #define _SBODY_PART_H_
 
 #include "fwd.h"
+class SSharedBuffer;
+class SSharedFile;
+struct iovec;
 
 //*****************************************************************************
 /*!
@@ -50,6 +53,9 @@ public:
                         // stage module to call an earlier stage module on demand 
                         // when it needs it and also with "howmuch" it needs given 
                         // the size of its buffers.
+        BP_SPOOLED,     // data is kept in memory till it gets large and is
+                        // then moved to a temporary file
+        BP_SEGMENTED,   // data is a chain of slices of shared buffers
         BP_NUM_TYPES    // define other types from here
     };
 
@@ -99,8 +105,14 @@ public:
 
 typedef std::vector<SBodyPart *>    SBodyPartVector;
 typedef std::list<SBodyPart *>      SBodyPartList;
-// A priority queue of body parts
-typedef std::priority_queue<SBodyPart *, SBodyPartVector, SBodyPartComparer>    SBodyPartQueue;
+// A priority queue of body parts - the queued parts can be looked at
+// (but not reordered) in place
+class SBodyPartQueue : public std::priority_queue<SBodyPart *, SBodyPartVector, SBodyPartComparer>
+{
+public:
+    //! The queued parts in no particular order
+    SBodyPartVector &Parts() { return c; }
+};
 
 //*****************************************************************************
 /*!
@@ -149,6 +161,10 @@ public:
     //! Writes the body to an FD - override for multipart messages
     virtual bool WriteToConnection(SConnection *pConn, int &numWritten);
 
+    //! Writes the body with MSG_ZEROCOPY - the part must then be kept
+    // till the kernel reports the send (numbered sequence) as complete.
+    virtual bool WriteToConnectionZeroCopy(SConnection *pConn, int &numWritten, long long &sequence);
+
 public:
     //! The data required for this body part
     SCharVector data;
@@ -173,7 +189,25 @@ public:
     SFileBodyPart(const SString &fname, size_t fsize,
                   unsigned index = 0, void *data = NULL);
 
-    virtual ~SFileBodyPart() { }
+    //! Closes the file if it is still open
+    virtual ~SFileBodyPart();
+
+    //! Only sends length bytes of the file starting at start
+    void SetRange(off_t start, size_t length);
+
+    //! Sends from an already open file instead of opening filename (the
+    // part takes its own reference).  The part's file then starts at
+    // fileOffset within it - eg for files packed in an archive.
+    void SetSharedFile(SSharedFile *pFile, off_t fileOffset = 0);
+
+    //! Tells if only a range of the file is sent
+    inline bool IsRange() const { return rangeStart != 0 || rangeEnd != (off_t)filesize; }
+
+    //! First byte of the file that is sent
+    inline off_t RangeStart() const { return rangeStart; }
+
+    //! Size of the whole file
+    inline size_t FileSize() const { return filesize; }
 
     //! Writes the body to stream from a given offset
     virtual int WriteToStream(std::ostream &output, int from = 0);
@@ -181,21 +215,240 @@ public:
     //! Writes the body to an FD from a given offset
     virtual bool WriteToConnection(SConnection *pConn, int &numWritten);
 
-    //! Get the data size
-    inline int Size() { return filesize; }
+    //! Get the size of the data sent
+    inline off_t Size() const { return rangeEnd - rangeStart; }
 
 public:
     SString filename;
 
+    //! Type of the file's content if the part needs to say (eg within
+    // multipart messages)
+    SString contentType;
+
 protected:
     //! FD of the file being sent
     int     readFD;
 
+    //! The open file being sent from if it is shared with other parts
+    SSharedFile *   pSharedFile;
+
     //! Size of the file
     size_t  filesize;
 
     //! Offset in the file being read
     off_t   offset;
+
+    //! Where the file starts in the shared file
+    off_t   fileOffset;
+
+    //! The range of the file that is sent - [rangeStart, rangeEnd)
+    off_t   rangeStart;
+    off_t   rangeEnd;
+};
+
+//*****************************************************************************
+/*!
+ *  \class  SSpooledBodyPart
+ *
+ *  \brief  Body parts that keep their data in memory till it grows past a
+ *  threshold, after which all of it is moved to an (unlinked) temporary
+ *  file.  Large uploads can then be read through FD() or an mmap'ed view
+ *  and sent on with sendfile without ever being held in memory.
+ *
+ *****************************************************************************/
+class SSpooledBodyPart : public SBodyPart
+{
+public:
+    SSpooledBodyPart(size_t threshold, unsigned index = 0, void *data = NULL);
+
+    virtual ~SSpooledBodyPart();
+
+    //! Appends raw bytes to the body, spooling to disk if necessary.
+    // Returns false if the spool file could not be written.
+    bool AppendToBody(const char *buffer, size_t size);
+
+    //! Tells if the data has been moved to a file
+    inline bool IsSpooled() const { return spoolFD >= 0; }
+
+    //! FD of the spool file (-1 if the data is still in memory)
+    inline int FD() const { return spoolFD; }
+
+    //! Get the data size
+    inline off_t Size() const { return dataSize; }
+
+    //! Returns a view of the whole body - mmap'ed if spooled.  The view
+    // is only valid till the next append.
+    const char *Data();
+
+    //! Writes the body to stream from a given offset
+    virtual int WriteToStream(std::ostream &output, int from = 0);
+
+    //! Writes the body to the connection (with sendfile if spooled)
+    virtual bool WriteToConnection(SConnection *pConn, int &numWritten);
+
+public:
+    //! Directory spool files are created in
+    static SString spoolDir;
+
+protected:
+    //! Moves the data into a new temporary file
+    bool SpoolToFile();
+
+    //! Removes the mmap'ed view if any
+    void Unmap();
+
+protected:
+    //! Size above which data is spooled
+    size_t      spoolThreshold;
+
+    //! Data while in memory
+    SCharVector data;
+
+    //! Size of the data (in memory or in the file)
+    off_t       dataSize;
+
+    //! FD of the spool file
+    int         spoolFD;
+
+    //! mmap'ed view of the spool file
+    char *      pMapped;
+
+    //! Offset in the data that has been written out
+    off_t       offset;
+};
+
+//*****************************************************************************
+/*!
+ *  \class  SSegmentedBodyPart
+ *
+ *  \brief  Body parts whose data is a chain of slices of shared buffers.
+ *
+ *  Slices can be added at either end without touching the data already in
+ *  the part (eg to put a boundary before a message) and the same buffer can
+ *  be referenced by any number of parts.  The writer sends the slices with
+ *  a single gathered write.
+ *
+ *****************************************************************************/
+class SSegmentedBodyPart : public SBodyPart
+{
+public:
+    //! A part of a shared buffer
+    struct Slice
+    {
+        SSharedBuffer * pBuffer;
+        const char *    pData;
+        size_t          length;
+    };
+
+public:
+    SSegmentedBodyPart(unsigned index = 0, void *data = NULL);
+
+    //! Drops the references to the buffers
+    virtual ~SSegmentedBodyPart();
+
+    //! Adds a slice of a buffer to the front
+    void Prepend(SSharedBuffer *pBuffer, size_t offset = 0, size_t length = (size_t)-1);
+
+    //! Adds a copy of some bytes to the front
+    void Prepend(const char *buffer, size_t size);
+
+    //! Adds a copy of a string to the front
+    void Prepend(const SString &data) { Prepend(data.c_str(), data.size()); }
+
+    //! Adds a slice of a buffer to the end
+    void Append(SSharedBuffer *pBuffer, size_t offset = 0, size_t length = (size_t)-1);
+
+    //! Adds a copy of some bytes to the end
+    void Append(const char *buffer, size_t size);
+
+    //! Adds a copy of a string to the end
+    void Append(const SString &data) { Append(data.c_str(), data.size()); }
+
+    //! Drops all the slices
+    void Clear();
+
+    //! Marks the part as a message of its own that may be dropped (or
+    // replaced by a later one with the same key) if the client falls
+    // behind.  Only parts that carry all of their framing can be dropped.
+    void SetDroppable(bool drop, const SString &key = "")
+    {
+        droppable       = drop;
+        conflationKey   = key;
+    }
+
+    //! Tells if the part may be dropped
+    inline bool IsDroppable() const { return droppable; }
+
+    //! Key of the message (parts with the same key replace each other)
+    inline const SString &ConflationKey() const { return conflationKey; }
+
+    //! Marks the part as holding (some of) a file's contents so it goes
+    // out as it is, like a file part would (eg it is not compressed)
+    void SetFileContents(bool yes) { fileContents = yes; }
+
+    //! Tells if the part holds a file's contents
+    inline bool IsFileContents() const { return fileContents; }
+
+    //! Get the data size
+    inline size_t Size() const { return dataSize; }
+
+    //! Gets the slices
+    inline const std::deque<Slice> &Slices() const { return slices; }
+
+    //! Fills upto maxIov entries with the data from the given offset
+    // onwards.  Returns the number of entries filled.
+    int FillIOVec(struct iovec *iov, int maxIov, size_t from) const;
+
+    //! Writes the body to stream from a given offset
+    virtual int WriteToStream(std::ostream &output, int from = 0);
+
+    //! Writes the body to the connection
+    virtual bool WriteToConnection(SConnection *pConn, int &numWritten);
+
+protected:
+    //! Makes a slice of a buffer (taking a reference to it)
+    static Slice MakeSlice(SSharedBuffer *pBuffer, size_t offset, size_t length);
+
+protected:
+    //! The slices in order
+    std::deque<Slice>   slices;
+
+    //! Total bytes in the slices
+    size_t              dataSize;
+
+    //! Bytes written so far by WriteToConnection
+    size_t              bytesWritten;
+
+    //! Whether the part may be dropped
+    bool                droppable;
+
+    //! Key of the message if it may be conflated
+    SString             conflationKey;
+
+    //! Whether the part holds a file's contents
+    bool                fileContents;
+};
+
+//*****************************************************************************
+/*!
+ *  \class  SBodyProducer
+ *
+ *  \brief  Generates the data of a lazy body part as and when the
+ *  connection can take it.
+ *
+ *****************************************************************************/
+class SBodyProducer
+{
+public:
+    virtual ~SBodyProducer() { }
+
+    //! Writes upto maxBytes of the next bytes of the body into buffer.
+    // Returns the number of bytes written, 0 once there is nothing more to
+    // produce or -1 if the data could not be produced.
+    virtual int Produce(char *buffer, int maxBytes) = 0;
+
+    //! Total number of bytes that will be produced (-1 if not known)
+    virtual long long Size() const { return -1; }
 };
 
 //*****************************************************************************
@@ -205,20 +458,63 @@ protected:
  *  \brief  A lazy body part - uses callbacks to generate data on fly
  *  (perhaps even more than once).
  *
+ *  The writer pulls data from the producer only when the socket has room
+ *  for it, asking for as much as the socket's send buffer can take, so a
+ *  slow client holds back the producer instead of the response piling up
+ *  in memory.  Parts of unknown size in chunked responses frame each pull
+ *  as a chunk of its own.
+ *
  *****************************************************************************/
 class SLazyBodyPart : public SBodyPart
 {
 public:
-    SLazyBodyPart(unsigned index = 0, void *data = NULL)
-        : SBodyPart(BP_LAZY, index, data) { }
+    //! Most bytes pulled from the producer at a time by default
+    static const size_t DEFAULT_MAX_PULL = 64 * 1024;
+
+public:
+    //! Creates a part that owns the producer
+    SLazyBodyPart(SBodyProducer *pProducer, unsigned index = 0, void *data = NULL);
+
+    //! Destroys the producer
+    virtual ~SLazyBodyPart();
 
-    virtual ~SLazyBodyPart() { }
+    //! Total size of the data (-1 if not known)
+    inline long long Size() const { return pProducer->Size(); }
+
+    //! Sets whether each pull is sent as a chunk
+    inline void SetChunked(bool chunk) { chunked = chunk; }
+
+    //! Sets the most bytes pulled from the producer at a time
+    inline void SetMaxPull(size_t maxBytes) { maxPull = maxBytes; }
 
     //! Writes the body to stream from a given offset
     virtual int WriteToStream(std::ostream &output, int from = 0);
 
     //! Writes the body to an FD from a given offset
     virtual bool WriteToConnection(SConnection *pConn, int &numWritten);
+
+protected:
+    //! Pulls upto maxBytes from the producer into the pending buffer.
+    // Returns false if the producer failed.
+    bool Pull(size_t maxBytes);
+
+protected:
+    //! Where the data comes from
+    SBodyProducer * pProducer;
+
+    //! Data pulled but not yet written - [pendingStart, pendingEnd)
+    SCharVector     pending;
+    size_t          pendingStart;
+    size_t          pendingEnd;
+
+    //! Whether the producer has run out of data
+    bool            finished;
+
+    //! Whether pulls are framed as chunks
+    bool            chunked;
+
+    //! Most bytes pulled at a time
+    size_t          maxPull;
 };
 
 #endif
@@ -31,6 +31,11 @@
 #include "stage.h"
 #include "handler.h"
 
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+
 /**************************************************************************************
 *   \brief  Creates a new connection object and required members.
 *
@@ -43,6 +48,8 @@ SConnection::SConnection(SEvServer *pSrv, int sock) :
         connSocket(sock),
         createdAt(time(NULL)),
         connState(STATE_IDLE),
+        zeroCopyEnabled(false),
+        zeroCopySequence(0),
         pReadBuffer(NULL),
         bufferLength(0),
         pCurrPos(NULL),
@@ -147,6 +154,124 @@ int SConnection::RefillBuffer(char *&pOutCurrPos, char *&pOutBuffEnd)
 int SConnection::WriteData(const char *buffer, int length)
 {
     int numWritten = send(Socket(), buffer, length, MSG_NOSIGNAL);
+    return WriteFinished(numWritten);
+}
+
+//! Writes a set of buffers to the connection
+int SConnection::WriteData(const struct iovec *iov, int iovcnt, bool more)
+{
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov     = const_cast<struct iovec *>(iov);
+    msg.msg_iovlen  = iovcnt;
+
+    int numWritten = sendmsg(Socket(), &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+    return WriteFinished(numWritten);
+}
+
+//! Tells roughly how many more bytes the socket's send buffer can take
+int SConnection::WritableBytes()
+{
+    int         sendBuffer  = 0;
+    int         queued      = 0;
+    socklen_t   optlen      = sizeof(sendBuffer);
+    if (getsockopt(Socket(), SOL_SOCKET, SO_SNDBUF, &sendBuffer, &optlen) != 0 ||
+        ioctl(Socket(), SIOCOUTQ, &queued) != 0)
+    {
+        return -1;
+    }
+    return sendBuffer > queued ? sendBuffer - queued : 0;
+}
+
+//! Turns on SO_ZEROCOPY for the socket
+bool SConnection::EnableZeroCopy()
+{
+#ifdef SO_ZEROCOPY
+    int one = 1;
+    if (setsockopt(Socket(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0)
+    {
+        zeroCopyEnabled = true;
+        return true;
+    }
+    SLogger::Get()->Log("DEBUG: SO_ZEROCOPY not available, Error [%d]: %s\n", errno, strerror(errno));
+#endif
+    return false;
+}
+
+//! Writes data with MSG_ZEROCOPY
+int SConnection::WriteDataZeroCopy(const char *buffer, int length, long long &sequence)
+{
+    sequence = -1;
+#ifdef MSG_ZEROCOPY
+    if (zeroCopyEnabled)
+    {
+        int numWritten = send(Socket(), buffer, length, MSG_NOSIGNAL | MSG_ZEROCOPY);
+        if (numWritten > 0)
+        {
+            // every call that sent something gets a number, even partial ones
+            sequence = zeroCopySequence++;
+            return numWritten;
+        }
+        else if (numWritten == 0)
+        {
+            return 0;
+        }
+        else if (errno != ENOBUFS)
+        {
+            return WriteFinished(numWritten);
+        }
+        // out of memory to pin the pages with - copy instead
+    }
+#endif
+    return WriteData(buffer, length);
+}
+
+//! Reads the next zero copy completion off the socket's error queue
+bool SConnection::NextZeroCopyCompletion(unsigned &first, unsigned &last, bool &copied)
+{
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    char            control[128];
+    struct msghdr   msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control     = control;
+    msg.msg_controllen  = sizeof(control);
+
+    while (recvmsg(Socket(), &msg, MSG_ERRQUEUE) >= 0)
+    {
+        for (struct cmsghdr *pCmsg = CMSG_FIRSTHDR(&msg);pCmsg != NULL;pCmsg = CMSG_NXTHDR(&msg, pCmsg))
+        {
+            if (!((pCmsg->cmsg_level == SOL_IP && pCmsg->cmsg_type == IP_RECVERR) ||
+                  (pCmsg->cmsg_level == SOL_IPV6 && pCmsg->cmsg_type == IPV6_RECVERR)))
+                continue ;
+
+            struct sock_extended_err *pError = (struct sock_extended_err *)CMSG_DATA(pCmsg);
+            if (pError->ee_errno == 0 && pError->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+            {
+                first   = pError->ee_info;
+                last    = pError->ee_data;
+                copied  = (pError->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+                return true;
+            }
+        }
+        msg.msg_controllen = sizeof(control);
+    }
+#endif
+    return false;
+}
+
+//! Gets (and clears) the pending socket error
+int SConnection::SocketError()
+{
+    int         error   = 0;
+    socklen_t   optlen  = sizeof(error);
+    if (getsockopt(Socket(), SOL_SOCKET, SO_ERROR, &error, &optlen) != 0)
+        return errno;
+    return error;
+}
+
+//! Handles errors from a write
+int SConnection::WriteFinished(int numWritten)
+{
     if (numWritten < 0)
     {
         if (errno == EPIPE || errno == ECONNRESET)
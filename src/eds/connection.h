@@ -37,6 +37,7 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/sendfile.h>
 #include <sys/epoll.h>
 #include <sys/time.h>
@@ -134,10 +135,43 @@ public:
     //! Writes data to the connection
     int WriteData(const char *buffer, int length);
 
+    //! Writes a set of buffers to the connection in one go - with more set
+    // the kernel is told more data follows so a partial segment is held back
+    int WriteData(const struct iovec *iov, int iovcnt, bool more = false);
+
+    //! Tells roughly how many more bytes the socket's send buffer can
+    // take right now (-1 if it cannot be found)
+    int WritableBytes();
+
+    //! Turns on SO_ZEROCOPY for the socket.  Returns false if the system
+    // does not support it.
+    bool EnableZeroCopy();
+
+    //! Tells if SO_ZEROCOPY is on for the socket
+    inline bool ZeroCopyEnabled() const { return zeroCopyEnabled; }
+
+    //! Writes data with MSG_ZEROCOPY - the buffer must be left alone till
+    // the kernel reports the send as complete.  sequence is set to the
+    // number of the send (that completions refer to) or -1 if the data
+    // had to be copied after all.
+    int WriteDataZeroCopy(const char *buffer, int length, long long &sequence);
+
+    //! Reads the next zero copy completion off the socket's error queue -
+    // sends first to last (inclusive) are done with their buffers and
+    // copied tells if the kernel ended up copying the data anyway.
+    // Returns false if there are no more completions.
+    bool NextZeroCopyCompletion(unsigned &first, unsigned &last, bool &copied);
+
+    //! Gets (and clears) the pending socket error
+    int SocketError();
+
 protected:
     //! Closes the underlying socket
     void CloseSocket();
 
+    //! Handles errors from a write and returns numWritten
+    int WriteFinished(int numWritten);
+
 private:
     //! The server parenting this connection
     SEvServer *         pServer;
@@ -151,6 +185,12 @@ private:
     //! Connection state
     int                 connState;
 
+    //! Whether SO_ZEROCOPY is on
+    bool                zeroCopyEnabled;
+
+    //! Number of the next zero copy send
+    unsigned            zeroCopySequence;
+
 public:
     //! Read buffers
     char *              pReadBuffer;
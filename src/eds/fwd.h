@@ -43,6 +43,7 @@
 #include <set>
 #include <vector>
 #include <list>
+#include <deque>
 #include <iomanip>
 #include <iostream>
 #include "logger/logger.h"
@@ -30,6 +30,7 @@
 #include "../request.h"
 #include "../response.h"
 #include "../../connection.h"
+#include "../../sharedbuffer.h"
 #include "json/json.h"
 #include "json/tokenizer.h"
 #include <uuid/uuid.h>
@@ -184,7 +185,10 @@ void SBayeuxModule::DeliverEvent(const SBayeuxChannel *pChannel, const JsonNodeP
     SStringStream msgstream;
     DefaultJsonFormatter formatter;
     formatter.Format(msgstream, realValue);
-    SString msgbody(msgstream.str());
+
+    // the message is formatted and copied once - every subscriber's part
+    // refers to the same buffer (and keeps its own write offset)
+    SSharedBuffer *pMessage = SSharedBuffer::Create(msgstream.str());
 
     SStringList *pClientList = iter->second;
     for (SStringList::iterator iter = pClientList->begin();iter != pClientList->end();++iter)
@@ -192,13 +196,18 @@ void SBayeuxModule::DeliverEvent(const SBayeuxChannel *pChannel, const JsonNodeP
         SHttpHandlerData *pHandlerData = GetClient(*iter);
         if (pHandlerData != NULL)
         {
-            SHttpRequest *      pRequest    = pHandlerData->Request();
-            SHttpResponse *     pResponse   = pRequest->Response();
-            SRawBodyPart *      pBodyPart   = pResponse->NewRawBodyPart();
-            pBodyPart->SetBody(msgbody);
+            SHttpRequest *          pRequest    = pHandlerData->Request();
+            SHttpResponse *         pResponse   = pRequest->Response();
+            SSegmentedBodyPart *    pBodyPart   = pResponse->NewSegmentedBodyPart();
+            pBodyPart->Append(pMessage);
+            // a client that falls behind can do without stale events
+            pBodyPart->SetDroppable(true, pChannel->Name());
             pHandlerStage->SendEvent_OutputToModule(pRequest->Connection(), pNextModule, pBodyPart);
         }
     }
+
+    // the parts hold on to the buffer for as long as they need it
+    pMessage->DecRef();
 }
 
 //! returns true if a character is a hyphen
@@ -230,13 +239,26 @@ void SBayeuxModule::ProcessInput(SConnection *          pConnection,
 
     if (pContent != NULL)
     {
-        SRawBodyPart *pRawPart = dynamic_cast<SRawBodyPart *>(pContent);
-        const SCharVector & reqBody         = pRawPart->Body();
+        // the body may have been spooled if it was large
+        const char *pBodyStart  = NULL;
+        const char *pBodyEnd    = NULL;
+        if (pContent->Type() == SBodyPart::BP_SPOOLED)
+        {
+            SSpooledBodyPart *pSpooledPart = (SSpooledBodyPart *)pContent;
+            pBodyStart  = pSpooledPart->Data();
+            pBodyEnd    = pBodyStart == NULL ? NULL : pBodyStart + pSpooledPart->Size();
+        }
+        else
+        {
+            const SCharVector & reqBody = ((SRawBodyPart *)pContent)->Body();
+            pBodyStart  = reqBody.empty() ? NULL : &reqBody[0];
+            pBodyEnd    = pBodyStart == NULL ? NULL : pBodyStart + reqBody.size();
+        }
+
         // parse the list of messages
-        DefaultJsonInputStream<SCharVector::const_iterator> instream(reqBody.begin(),
-                                                                     reqBody.end());
+        DefaultJsonInputStream<const char *> instream(pBodyStart, pBodyEnd);
         cout << "Bayeux Body: ";
-        copy(reqBody.begin(), reqBody.end(), std::ostreambuf_iterator<char>(cout));
+        copy(pBodyStart, pBodyEnd, std::ostreambuf_iterator<char>(cout));
         cout << endl;
 
         DefaultJsonBuilder jbuilder;
@@ -0,0 +1,452 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   bundle.cpp
+ *
+ *  \brief  Archives of static files packed into a single indexed file.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include "bundle.h"
+#include "eds/utils.h"
+#include "eds/sharedfile.h"
+#include "utils/mimetypes.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+//! Identifies an archive (and its version)
+const char SAssetBundle::MAGIC[8] = { 'H', 'A', 'L', 'B', 'N', 'D', 'L', '1' };
+
+//! Data starts on a page boundary after the index
+static const uint64_t DATA_ALIGNMENT = 4096;
+
+//! Hashes bytes (64 bit FNV-1a)
+uint64_t SAssetBundle::HashBytes(const char *data, size_t length, uint64_t hash)
+{
+    for (size_t i = 0;i < length;i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+//! Creates a bundle over an opened archive and its mmap'ed index
+SAssetBundle::SAssetBundle(const SString &path, SSharedFile *pArchive, void *pMappedIndex, size_t size)
+:
+    archivePath(path),
+    pFile(pArchive),
+    pIndex(pMappedIndex),
+    indexSize(size)
+{
+    const char *pBase = (const char *)pIndex;
+    pHeader     = (const Header *)pBase;
+    pEntries    = (const Entry *)(pBase + sizeof(Header));
+    pSlots      = (const uint32_t *)(pEntries + pHeader->numEntries);
+    pStrings    = pBase + pHeader->stringsOffset;
+}
+
+//! Unmaps the index and drops the archive
+SAssetBundle::~SAssetBundle()
+{
+    munmap(pIndex, indexSize);
+    pFile->DecRef();
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Opens an archive and mmaps its index.
+ *
+ *  The whole index is checked once here so that lookups and sends never
+ *  have to - an archive that is truncated or not an archive is rejected.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+SAssetBundle *SAssetBundle::Open(const SString &archivePath)
+{
+    SSharedFile *pArchive = SSharedFile::Open(archivePath);
+    if (pArchive == NULL)
+        return NULL;
+
+    struct stat archiveStat;
+    Header      header;
+    if (fstat(pArchive->FD(), &archiveStat) != 0 ||
+        pread(pArchive->FD(), &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.archiveSize != (uint64_t)archiveStat.st_size ||
+        header.indexSize < sizeof(Header) || header.indexSize > header.archiveSize)
+    {
+        SLogger::Get()->Log("ERROR: Not an asset bundle: %s\n", archivePath.c_str());
+        pArchive->DecRef();
+        return NULL;
+    }
+
+    void *pIndex = mmap(NULL, header.indexSize, PROT_READ, MAP_SHARED, pArchive->FD(), 0);
+    if (pIndex == MAP_FAILED)
+    {
+        SLogger::Get()->Log("ERROR: Could not map asset bundle: %s, Error [%d]: %s\n",
+                            archivePath.c_str(), errno, strerror(errno));
+        pArchive->DecRef();
+        return NULL;
+    }
+
+    // the layout has to be checked before the parts of the index are found
+    uint64_t tablesEnd = sizeof(Header) + header.numEntries * (uint64_t)sizeof(Entry) +
+                         header.numSlots * (uint64_t)sizeof(uint32_t);
+    if (tablesEnd > header.stringsOffset || header.stringsSize == 0 ||
+        header.stringsOffset + header.stringsSize > header.indexSize)
+    {
+        SLogger::Get()->Log("ERROR: Corrupt asset bundle: %s\n", archivePath.c_str());
+        munmap(pIndex, header.indexSize);
+        pArchive->DecRef();
+        return NULL;
+    }
+
+    SAssetBundle *pBundle = new SAssetBundle(archivePath, pArchive, pIndex, header.indexSize);
+    if (!pBundle->Validate(archiveStat.st_size))
+    {
+        SLogger::Get()->Log("ERROR: Corrupt asset bundle: %s\n", archivePath.c_str());
+        delete pBundle;
+        return NULL;
+    }
+    return pBundle;
+}
+
+//! Checks that all the offsets in the index are within the archive
+bool SAssetBundle::Validate(off_t fileSize) const
+{
+    uint32_t numSlots = pHeader->numSlots;
+    if (numSlots <= pHeader->numEntries || (numSlots & (numSlots - 1)) != 0 ||
+        pStrings[pHeader->stringsSize - 1] != 0)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0;i < numSlots;i++)
+    {
+        if (pSlots[i] > pHeader->numEntries)
+            return false;
+    }
+
+    uint64_t dataStart  = pHeader->indexSize;
+    uint64_t dataEnd    = fileSize;
+    for (uint32_t i = 0;i < pHeader->numEntries;i++)
+    {
+        const Entry &entry = pEntries[i];
+        if (entry.pathOffset >= pHeader->stringsSize ||
+            entry.mimeOffset >= pHeader->stringsSize ||
+            entry.etagOffset >= pHeader->stringsSize ||
+            !HasBlob(&entry, BLOB_IDENTITY))
+        {
+            return false;
+        }
+        for (int blob = 0;blob < NUM_BLOBS;blob++)
+        {
+            if (HasBlob(&entry, blob) &&
+                (entry.blobs[blob].offset < dataStart || entry.blobs[blob].offset > dataEnd ||
+                 entry.blobs[blob].size > dataEnd - entry.blobs[blob].offset))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//! Finds the entry of a file (NULL if it is not in the archive)
+const SAssetBundle::Entry *SAssetBundle::Find(const SString &path) const
+{
+    uint64_t    hash    = HashBytes(path.c_str(), path.size());
+    uint32_t    mask    = pHeader->numSlots - 1;
+    uint32_t    slot    = hash & mask;
+    for (uint32_t probes = 0;probes < pHeader->numSlots;probes++, slot = (slot + 1) & mask)
+    {
+        if (pSlots[slot] == 0)
+            return NULL;
+
+        const Entry *pEntry = pEntries + pSlots[slot] - 1;
+        if (pEntry->pathHash == hash && strcmp(Path(pEntry), path.c_str()) == 0)
+            return pEntry;
+    }
+    return NULL;
+}
+
+/************************************************************************
+ *
+ *                              Packing
+ *
+ ***********************************************************************/
+//! A file found under the docroot
+struct SPackedFile
+{
+    SString     fullPath;
+    struct stat fileStat;
+};
+
+typedef std::map<SString, SPackedFile>  SPackedFileMap;
+
+//! Finds the regular files in a folder and its sub folders (symbolic links
+// to folders are not followed)
+static bool FindFiles(const SString &docroot, const SString &relPath, SPackedFileMap &files)
+{
+    SString folder  = docroot + relPath;
+    DIR *   pDir    = opendir(folder.c_str());
+    if (pDir == NULL)
+    {
+        SLogger::Get()->Log("ERROR: Could not open folder: %s, Error [%d]: %s\n",
+                            folder.c_str(), errno, strerror(errno));
+        return false;
+    }
+
+    bool            result = true;
+    struct dirent * pEntry;
+    while (result && (pEntry = readdir(pDir)) != NULL)
+    {
+        if (strcmp(pEntry->d_name, ".") == 0 || strcmp(pEntry->d_name, "..") == 0)
+            continue ;
+
+        SPackedFile file;
+        SString     childPath   = relPath + "/" + pEntry->d_name;
+        file.fullPath           = docroot + childPath;
+        if (lstat(file.fullPath.c_str(), &file.fileStat) != 0)
+            continue ;
+        if (S_ISDIR(file.fileStat.st_mode))
+            result = FindFiles(docroot, childPath, files);
+        else if (stat(file.fullPath.c_str(), &file.fileStat) == 0 && S_ISREG(file.fileStat.st_mode))
+            files[childPath] = file;
+    }
+    closedir(pDir);
+    return result;
+}
+
+//! Writes all of a buffer at an offset
+static bool WriteAll(int fd, const char *data, size_t length, off_t offset)
+{
+    while (length > 0)
+    {
+        ssize_t numWritten = pwrite(fd, data, length, offset);
+        if (numWritten < 0 && errno == EINTR)
+            continue ;
+        if (numWritten <= 0)
+            return false;
+        data    += numWritten;
+        length  -= numWritten;
+        offset  += numWritten;
+    }
+    return true;
+}
+
+//! Copies a file into the archive, hashing what is copied.  Fails if the
+// file is not the size it was when found.
+static bool CopyFile(int archiveFD, const SPackedFile &file, uint64_t offset, uint64_t &hash)
+{
+    int fd = open(file.fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        SLogger::Get()->Log("ERROR: Could not open file: %s, Error [%d]: %s\n",
+                            file.fullPath.c_str(), errno, strerror(errno));
+        return false;
+    }
+
+    char        buffer[1 << 16];
+    uint64_t    numCopied   = 0;
+    ssize_t     numRead     = 0;
+    while ((numRead = read(fd, buffer, sizeof(buffer))) > 0 &&
+           numCopied + numRead <= (uint64_t)file.fileStat.st_size)
+    {
+        if (!WriteAll(archiveFD, buffer, numRead, offset + numCopied))
+        {
+            close(fd);
+            return false;
+        }
+        hash        = SAssetBundle::HashBytes(buffer, numRead, hash);
+        numCopied  += numRead;
+    }
+    close(fd);
+
+    if (numRead != 0 || numCopied != (uint64_t)file.fileStat.st_size)
+    {
+        SLogger::Get()->Log("ERROR: File changed while being packed: %s\n", file.fullPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Packs the regular files under a docroot into an archive.
+ *
+ *  The layout is worked out first (ETags are of a fixed length), then the
+ *  data is copied in while each file's contents are hashed for its ETag
+ *  and finally the index is written ahead of the data.  Files are stored
+ *  in the order of their paths so packing the same tree twice gives the
+ *  same archive.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+bool SAssetBundle::Pack(const SString &docroot, const SString &archivePath)
+{
+    SPackedFileMap files;
+    if (!FindFiles(docroot, "", files))
+        return false;
+
+    // copies next to their files are stored with them
+    std::vector<const SPackedFileMap::value_type *> packed;
+    for (SPackedFileMap::const_iterator iter = files.begin();iter != files.end();++iter)
+    {
+        bool isCopy = false;
+        for (int i = 0;!isCopy && i < SFileCacheEntry::NUM_VARIANTS;i++)
+        {
+            const char *    extension   = SFileCacheEntry::VARIANT_EXTENSIONS[i];
+            size_t          extLength   = strlen(extension);
+            const SString & path        = iter->first;
+            if (path.size() > extLength && path.compare(path.size() - extLength, extLength, extension) == 0)
+            {
+                SPackedFileMap::const_iterator original = files.find(path.substr(0, path.size() - extLength));
+                isCopy = original != files.end() &&
+                         iter->second.fileStat.st_mtime >= original->second.fileStat.st_mtime;
+            }
+        }
+        if (!isCopy)
+            packed.push_back(&*iter);
+    }
+
+    // lay out the strings - the ETags are filled in as the files are copied
+    static const size_t ETAG_LENGTH = 18;
+    Header              header;
+    std::vector<Entry>  entries(packed.size());
+    SString             strings;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    strings.append(1, '\0');
+    for (size_t i = 0;i < packed.size();i++)
+    {
+        const SString &path = packed[i]->first;
+        Entry &entry        = entries[i];
+        memset(&entry, 0, sizeof(entry));
+        entry.pathHash      = HashBytes(path.c_str(), path.size());
+        entry.pathOffset    = strings.size();
+        strings.append(path.c_str(), path.size() + 1);
+        entry.mimeOffset    = strings.size();
+        SString mimeType    = SMimeTypes::GetInstance()->GetMimeType(path);
+        strings.append(mimeType.c_str(), mimeType.size() + 1);
+        entry.etagOffset    = strings.size();
+        strings.append(ETAG_LENGTH + 1, '\0');
+        entry.lastModified  = packed[i]->second.fileStat.st_mtime;
+    }
+
+    header.numEntries       = entries.size();
+    header.numSlots         = 16;
+    while (header.numSlots < 2 * header.numEntries)
+        header.numSlots    *= 2;
+    header.stringsOffset    = sizeof(Header) + entries.size() * sizeof(Entry) +
+                              header.numSlots * sizeof(uint32_t);
+    header.stringsSize      = strings.size();
+    header.indexSize        = (header.stringsOffset + header.stringsSize + DATA_ALIGNMENT - 1) &
+                                ~(DATA_ALIGNMENT - 1);
+
+    std::vector<uint32_t> slots(header.numSlots, 0);
+    for (size_t i = 0;i < entries.size();i++)
+    {
+        uint32_t slot = entries[i].pathHash & (header.numSlots - 1);
+        while (slots[slot] != 0)
+            slot = (slot + 1) & (header.numSlots - 1);
+        slots[slot] = i + 1;
+    }
+
+    SString tempPath(archivePath + ".tmp");
+    int     fd      = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        SLogger::Get()->Log("ERROR: Could not create archive: %s, Error [%d]: %s\n",
+                            tempPath.c_str(), errno, strerror(errno));
+        return false;
+    }
+
+    // copy the files and their precompressed copies
+    bool        result      = true;
+    uint64_t    dataOffset  = header.indexSize;
+    for (size_t i = 0;result && i < packed.size();i++)
+    {
+        Entry &entry = entries[i];
+        for (int blob = 0;result && blob < NUM_BLOBS;blob++)
+        {
+            const SPackedFile *pFile = &packed[i]->second;
+            if (blob != BLOB_IDENTITY)
+            {
+                SPackedFileMap::const_iterator copy =
+                    files.find(packed[i]->first + SFileCacheEntry::VARIANT_EXTENSIONS[blob - 1]);
+                if (copy == files.end() || copy->second.fileStat.st_mtime < pFile->fileStat.st_mtime)
+                    continue ;
+                pFile = &copy->second;
+            }
+
+            uint64_t hash   = HASH_BASIS;
+            result          = CopyFile(fd, *pFile, dataOffset, hash);
+            if (blob == BLOB_IDENTITY)
+            {
+                char etag[ETAG_LENGTH + 1];
+                snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long)hash);
+                memcpy(&strings[entry.etagOffset], etag, ETAG_LENGTH);
+            }
+            entry.blobFlags            |= 1U << blob;
+            entry.blobs[blob].offset    = dataOffset;
+            entry.blobs[blob].size      = pFile->fileStat.st_size;
+            dataOffset                 += pFile->fileStat.st_size;
+        }
+    }
+
+    // then the index in front of them
+    header.archiveSize = dataOffset;
+    result = result &&
+             WriteAll(fd, (const char *)&header, sizeof(header), 0) &&
+             (entries.empty() ||
+              WriteAll(fd, (const char *)&entries[0], entries.size() * sizeof(Entry), sizeof(Header))) &&
+             WriteAll(fd, (const char *)&slots[0], slots.size() * sizeof(uint32_t),
+                      sizeof(Header) + entries.size() * sizeof(Entry)) &&
+             WriteAll(fd, strings.c_str(), strings.size(), header.stringsOffset) &&
+             ftruncate(fd, header.archiveSize) == 0 &&
+             fsync(fd) == 0;
+    if (close(fd) != 0)
+        result = false;
+
+    if (result && rename(tempPath.c_str(), archivePath.c_str()) != 0)
+    {
+        SLogger::Get()->Log("ERROR: Could not rename archive: %s, Error [%d]: %s\n",
+                            tempPath.c_str(), errno, strerror(errno));
+        result = false;
+    }
+    if (!result)
+    {
+        SLogger::Get()->Log("ERROR: Could not pack %s into %s\n", docroot.c_str(), archivePath.c_str());
+        unlink(tempPath.c_str());
+    }
+    return result;
+}
+
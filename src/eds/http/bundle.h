@@ -0,0 +1,177 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   bundle.h
+ *
+ *  \brief  Archives of static files packed into a single indexed file.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#ifndef _SASSET_BUNDLE_H_
+#define _SASSET_BUNDLE_H_
+
+#include "eds/fwd.h"
+#include "filecache.h"
+#include <stdint.h>
+
+class SSharedFile;
+
+//*****************************************************************************
+/*!
+ *  \class  SAssetBundle
+ *
+ *  \brief  A read only archive of the files under a docroot along with
+ *  their mime types, ETags and precompressed copies.
+ *
+ *  The archive is laid out as:
+ *
+ *      Header | Entry[numEntries] | slots[numSlots] | strings | pad | data
+ *
+ *  Everything before the data is the index, which is mmap'ed when the
+ *  archive is opened.  The slots are an open addressed (linearly probed)
+ *  hash table of 1 + the index of an entry by the hash of its path (0 for
+ *  empty slots).  Paths (relative to the docroot and starting with "/"),
+ *  mime types and ETags are NUL terminated strings.  The data of each
+ *  file and its copies is sent straight from the archive with sendfile.
+ *
+ *  Integers are in the byte order of the machine that packed the archive.
+ *
+ *****************************************************************************/
+class SAssetBundle
+{
+public:
+    //! Identifies an archive (and its version)
+    static const char       MAGIC[8];
+
+    //! Starting value of hashes
+    static const uint64_t   HASH_BASIS = 14695981039346656037ULL;
+
+    //! The copies stored for a file - the file itself followed by its
+    // precompressed copies in the file cache's order
+    enum
+    {
+        BLOB_IDENTITY,
+        NUM_BLOBS = 1 + SFileCacheEntry::NUM_VARIANTS
+    };
+
+    //! Start of an archive
+    struct Header
+    {
+        char        magic[8];
+        uint32_t    numEntries;
+        uint32_t    numSlots;       // a power of 2 more than numEntries
+        uint64_t    stringsOffset;
+        uint64_t    stringsSize;
+        uint64_t    indexSize;      // where the data starts
+        uint64_t    archiveSize;
+    };
+
+    //! Where a stored copy is in the archive
+    struct Blob
+    {
+        uint64_t    offset;
+        uint64_t    size;
+    };
+
+    //! A file in the archive
+    struct Entry
+    {
+        uint64_t    pathHash;
+        uint32_t    pathOffset;     // offsets into the strings
+        uint32_t    mimeOffset;
+        uint32_t    etagOffset;
+        uint32_t    blobFlags;      // bit i is set if blob i is stored
+        int64_t     lastModified;
+        Blob        blobs[NUM_BLOBS];
+    };
+
+public:
+    //! Opens and checks an archive (NULL if it cannot be opened or is
+    // not a valid archive)
+    static SAssetBundle *Open(const SString &archivePath);
+
+    //! Packs the regular files under a docroot into an archive.  A .br or
+    // .gz file is stored as a copy of the file it is next to if that
+    // exists and is not newer.  The archive is written to a temporary
+    // file and renamed into place so it can be replaced while served.
+    static bool Pack(const SString &docroot, const SString &archivePath);
+
+    //! Hashes bytes (64 bit FNV-1a) - continuing from an earlier hash if
+    // one is given
+    static uint64_t HashBytes(const char *data, size_t length, uint64_t hash = HASH_BASIS);
+
+    //! Unmaps the index and drops the archive
+    virtual ~SAssetBundle();
+
+    //! Finds the entry of a file (NULL if it is not in the archive)
+    const Entry *Find(const SString &path) const;
+
+    //! Tells if a copy of a file is stored
+    inline bool HasBlob(const Entry *pEntry, int blob) const
+    {
+        return (pEntry->blobFlags & (1U << blob)) != 0;
+    }
+
+    //! Strings of an entry
+    inline const char *Path(const Entry *pEntry) const { return pStrings + pEntry->pathOffset; }
+    inline const char *MimeType(const Entry *pEntry) const { return pStrings + pEntry->mimeOffset; }
+    inline const char *ETag(const Entry *pEntry) const { return pStrings + pEntry->etagOffset; }
+
+    //! Number of files in the archive
+    inline size_t NumEntries() const { return pHeader->numEntries; }
+
+    //! The open archive that files are sent from
+    inline SSharedFile *File() const { return pFile; }
+
+    //! Path of the archive
+    inline const SString &ArchivePath() const { return archivePath; }
+
+protected:
+    //! Only created by Open
+    SAssetBundle(const SString &path, SSharedFile *pArchive, void *pIndex, size_t size);
+
+    //! Checks that all the offsets in the index are within the archive
+    bool Validate(off_t fileSize) const;
+
+private:
+    //! Not copyable
+    SAssetBundle(const SAssetBundle &);
+    SAssetBundle &operator=(const SAssetBundle &);
+
+protected:
+    //! Path of the archive
+    SString             archivePath;
+
+    //! The open archive
+    SSharedFile *       pFile;
+
+    //! The mmap'ed index
+    void *              pIndex;
+    size_t              indexSize;
+
+    //! Parts of the index
+    const Header *      pHeader;
+    const Entry *       pEntries;
+    const uint32_t *    pSlots;
+    const char *        pStrings;
+};
+
+#endif
+
@@ -0,0 +1,107 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   bundlemodule.cpp
+ *
+ *  \brief  A module for serving static files from an asset bundle.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include "bundlemodule.h"
+#include "handlerstage.h"
+#include "request.h"
+#include "response.h"
+
+//*****************************************************************************
+/*!
+ *  \brief  Looks the requested path up in the bundle and sends the file
+ *  (or the copy of it the client prefers) straight from the bundle.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+void SBundleModule::ProcessInput(SConnection *          pConnection,
+                                 SHttpHandlerData *     pHandlerData,
+                                 SHttpHandlerStage *    pStage,
+                                 SBodyPart *            pBodyPart)
+{
+    SHttpRequest *  pRequest    = pHandlerData->Request();
+    SHttpResponse * pResponse   = pRequest->Response();
+    SHeaderTable &  respHeaders = pResponse->Headers();
+
+    SString docroot;
+    SString child;
+    SString prefix;
+    const SAssetBundle::Entry *pEntry = NULL;
+    if (pBundle != NULL && ParsePath(pRequest->Resource(), docroot, child, prefix))
+    {
+        SString path(docroot + child);
+        if (path.empty() || path[path.size() - 1] == '/')
+            path += "index.html";
+        pEntry = pBundle->Find(path);
+    }
+
+    if (pEntry == NULL)
+    {
+        pResponse->SetStatus(404, "Not Found");
+        respHeaders.SetHeader(HDR_CONTENT_TYPE, "text/text");
+        SRawBodyPart *pRawPart = pResponse->NewRawBodyPart();
+        pRawPart->SetBody("File not found.");
+        pStage->SendEvent_OutputToModule(pConnection, pNextModule, pRawPart);
+        pStage->SendEvent_OutputToModule(pConnection, pNextModule,
+                               pResponse->NewContFinishedPart(pNextModule));
+        return ;
+    }
+
+    SString contentType(pBundle->MimeType(pEntry));
+    respHeaders.SetHeader(HDR_CONTENT_TYPE, contentType);
+
+    // send a precompressed copy instead if there is one
+    int         blob        = SAssetBundle::BLOB_IDENTITY;
+    const char *encoding    = NULL;
+    if (servePrecompressed)
+    {
+        bool available[SFileCacheEntry::NUM_VARIANTS];
+        bool hasVariants = false;
+        for (int i = 0;i < SFileCacheEntry::NUM_VARIANTS;i++)
+        {
+            available[i] = pBundle->HasBlob(pEntry, i + 1);
+            hasVariants  = hasVariants || available[i];
+        }
+
+        int variant = ChoosePrecompressed(pRequest, available);
+        if (variant >= 0)
+        {
+            blob        = variant + 1;
+            encoding    = SFileCacheEntry::VARIANT_ENCODINGS[variant];
+            respHeaders.SetHeader(HDR_CONTENT_ENCODING, encoding);
+        }
+        if (hasVariants)
+            respHeaders.SetHeader(HDR_VARY, "Accept-Encoding");
+    }
+
+    const SAssetBundle::Blob &sendBlob = pEntry->blobs[blob];
+    SendRepresentation(pConnection, pStage, pRequest, pBundle->ArchivePath(), pBundle->File(),
+                       sendBlob.offset, sendBlob.size, NULL, contentType,
+                       EncodedETag(pBundle->ETag(pEntry), encoding), pEntry->lastModified);
+}
+
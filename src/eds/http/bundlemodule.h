@@ -0,0 +1,66 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   bundlemodule.h
+ *
+ *  \brief  A module for serving static files from an asset bundle.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#ifndef _SBUNDLE_MODULE_H_
+#define _SBUNDLE_MODULE_H_
+
+#include "filemodule.h"
+#include "bundle.h"
+
+//! A module for serving static files packed into an asset bundle.
+//
+// Doc roots are folders within the bundle (eg "/" for all of it) and a
+// path ending in "/" gets its index.html.  Lookups are a single probe of
+// the bundle's mmap'ed index (nothing is stat'ed or opened per request)
+// and files are sent from the bundle with sendfile.  Precompressed copies,
+// ETags, conditional GETs and ranges are handled as by SFileModule.
+class SBundleModule : public SFileModule
+{
+public:
+    //! Creates the module
+    SBundleModule(SHttpModule *pNext, SAssetBundle *pAssetBundle = NULL) :
+        SFileModule(pNext), pBundle(pAssetBundle) { }
+
+    //! Destructor
+    virtual ~SBundleModule() { }
+
+    //! Sets the bundle files are served from (not owned - it must outlive
+    // the module's requests)
+    void SetBundle(SAssetBundle *pAssetBundle) { pBundle = pAssetBundle; }
+
+    //! Called to handle input data from another module
+    virtual void ProcessInput(SConnection *         pConnection,
+                              SHttpHandlerData *    pHandlerData,
+                              SHttpHandlerStage *   pStage,
+                              SBodyPart *           pBodyPart);
+
+protected:
+    //! The bundle files are served from
+    SAssetBundle *  pBundle;
+};
+
+#endif
+
@@ -0,0 +1,437 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   compressmodule.cpp
+ *
+ *  \brief  A module that gzip/deflate compresses response bodies.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include "compressmodule.h"
+#include "eds/connection.h"
+#include "eds/bodypart.h"
+#include "handlerstage.h"
+#include "request.h"
+#include "response.h"
+
+//! Size of the parts compressed output is collected in
+static const size_t COMPRESSED_PART_SIZE = 16 * 1024;
+
+//! Creates the module data
+SCompressionModuleData::SCompressionModuleData() :
+    decided(false),
+    encoding(SCompressionModule::ENCODING_NONE),
+    flushEachPart(false),
+    aborted(false),
+    zstreamReady(false),
+    zstreamEncoding(SCompressionModule::ENCODING_NONE),
+    zstreamLevel(0)
+{
+    memset(&zstream, 0, sizeof(zstream));
+}
+
+//! Frees the zlib stream
+SCompressionModuleData::~SCompressionModuleData()
+{
+    if (zstreamReady)
+        deflateEnd(&zstream);
+}
+
+//! Creates the module
+SCompressionModule::SCompressionModule(SHttpModule *pNext, int level) :
+    SHttpModule(pNext),
+    compressionLevel(level),
+    zlibWindowBits(14),
+    zlibMemLevel(7),
+    minSize(256)
+{
+    mimeTypes.push_back("text/");
+    mimeTypes.push_back("application/json");
+    mimeTypes.push_back("application/javascript");
+    mimeTypes.push_back("application/xml");
+    mimeTypes.push_back("image/svg+xml");
+}
+
+//! Compresses the body parts of responses that are worth compressing
+void SCompressionModule::ProcessOutput(SConnection *        pConnection,
+                                       SHttpHandlerData *   pHandlerData,
+                                       SHttpHandlerStage *  pStage,
+                                       SBodyPart *          pBodyPart)
+{
+    SCompressionModuleData *pModData = dynamic_cast<SCompressionModuleData *>(pHandlerData->GetModuleData(this, true));
+
+    // already being processed quit
+    // TODO: not yet thread safe
+    if (pModData->IsProcessing())
+        return ;
+
+    pModData->SetProcessing(true);
+
+    if (pBodyPart != NULL)
+    {
+        pBodyPart               = pModData->PutAndGetBodyPart(pBodyPart);
+        while (pBodyPart != NULL)
+        {
+            HandleBodyPart(pConnection, pHandlerData, pStage, pModData, pBodyPart);
+
+            pBodyPart = pModData->NextBodyPart();
+        }
+    }
+    else
+    {
+        SendBodyPartToModule(pConnection, pStage, pHandlerData->Request(), pBodyPart, pModData, pNextModule);
+    }
+
+    // turn off processing flag so it can be resumed in the future
+    pModData->SetProcessing(false);
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Tells how much a client accepts an encoding going by its
+ *  Accept-Encoding header.
+ *
+ *  Returns the quality (times 1000) the encoding (or "*") was listed
+ *  with, or -1 if it was not listed.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+int SCompressionModule::EncodingQuality(const SString &acceptEncoding, const char *encoding)
+{
+    int         wildQuality = -1;
+    size_t      encLength   = strlen(encoding);
+    const char *pCurr       = acceptEncoding.c_str();
+
+    while (*pCurr)
+    {
+        while (*pCurr == ' ' || *pCurr == '\t' || *pCurr == ',') pCurr++;
+        const char *pName = pCurr;
+        while (*pCurr && *pCurr != ',' && *pCurr != ';' && *pCurr != ' ' && *pCurr != '\t') pCurr++;
+        size_t nameLength = pCurr - pName;
+        if (nameLength == 0)
+            break ;
+
+        // parameters - only q matters
+        int quality = 1000;
+        while (*pCurr && *pCurr != ',')
+        {
+            if (*pCurr == ';')
+            {
+                pCurr++;
+                while (*pCurr == ' ' || *pCurr == '\t') pCurr++;
+                if ((*pCurr == 'q' || *pCurr == 'Q') && pCurr[1] == '=')
+                    quality = (int)(strtod(pCurr + 2, NULL) * 1000);
+            }
+            else
+            {
+                pCurr++;
+            }
+        }
+
+        if (nameLength == encLength && strncasecmp(pName, encoding, encLength) == 0)
+            return quality;
+        else if (nameLength == 1 && *pName == '*')
+            wildQuality = quality;
+    }
+    return wildQuality;
+}
+
+//! Tells if a content type is one to compress
+bool SCompressionModule::CompressesMimeType(const SString &contentType) const
+{
+    // ignore parameters like charset
+    size_t typeLength = contentType.find(';');
+    if (typeLength == SString::npos)
+        typeLength = contentType.size();
+    while (typeLength > 0 && isspace(contentType[typeLength - 1]))
+        typeLength--;
+
+    for (SStringList::const_iterator iter = mimeTypes.begin();iter != mimeTypes.end();++iter)
+    {
+        const SString &mimeType = *iter;
+        bool isPrefix = !mimeType.empty() && mimeType[mimeType.size() - 1] == '/';
+        if (isPrefix ? (typeLength > mimeType.size() &&
+                        strncasecmp(contentType.c_str(), mimeType.c_str(), mimeType.size()) == 0)
+                     : (typeLength == mimeType.size() &&
+                        strncasecmp(contentType.c_str(), mimeType.c_str(), typeLength) == 0))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Decides (when the first part comes through) whether the
+ *  response is to be compressed and if so fixes up its headers.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+void SCompressionModule::DecideEncoding(SHttpRequest *pRequest, SCompressionModuleData *pModData, SBodyPart *pFirstPart)
+{
+    SHttpResponse * pResponse   = pRequest->Response();
+    SHeaderTable &  respHeaders = pResponse->Headers();
+    int             statusCode  = pResponse->StatusCode();
+
+    pModData->decided   = true;
+    pModData->encoding  = ENCODING_NONE;
+
+    if (statusCode < 200 || statusCode == 204 || statusCode == 304 ||
+        pRequest->Method() == "HEAD" || pResponse->IsMultipart() ||
+        respHeaders.HasHeader(HDR_CONTENT_ENCODING) ||
+        !CompressesMimeType(respHeaders.Header(HDR_CONTENT_TYPE)))
+    {
+        return ;
+    }
+
+    // the response depends on Accept-Encoding from here on
+    const SString *pVary = respHeaders.HeaderValue(HDR_VARY);
+    if (pVary == NULL)
+        respHeaders.SetHeader(HDR_VARY, "Accept-Encoding");
+    else if (strcasestr(pVary->c_str(), "Accept-Encoding") == NULL && *pVary != "*")
+        respHeaders.SetHeader(HDR_VARY, *pVary + ", Accept-Encoding");
+
+    // files etc are left to go out as they are
+    int firstType = pFirstPart->Type();
+    if ((firstType != SBodyPart::BP_RAW && firstType != SBodyPart::BP_SEGMENTED) ||
+        (firstType == SBodyPart::BP_SEGMENTED && ((SSegmentedBodyPart *)pFirstPart)->IsFileContents()))
+    {
+        return ;
+    }
+
+    // streamed responses are compressed whatever their size
+    bool streamed = respHeaders.HasHeader(HDR_TRANSFER_ENCODING);
+    if (!streamed)
+    {
+        off_t contentLength = respHeaders.ContentLength();
+        if (!respHeaders.HasHeader(HDR_CONTENT_LENGTH))
+        {
+            contentLength = firstType == SBodyPart::BP_RAW ?
+                                dynamic_cast<SRawBodyPart *>(pFirstPart)->Size() :
+                                dynamic_cast<SSegmentedBodyPart *>(pFirstPart)->Size();
+        }
+        if (contentLength < 0 || (size_t)contentLength < minSize)
+            return ;
+    }
+
+    const SString *pAccept = pRequest->Headers().HeaderValue(HDR_ACCEPT_ENCODING);
+    if (pAccept == NULL)
+        return ;
+
+    int gzipQuality     = EncodingQuality(*pAccept, "gzip");
+    int deflateQuality  = EncodingQuality(*pAccept, "deflate");
+    if (gzipQuality <= 0)
+        gzipQuality = EncodingQuality(*pAccept, "x-gzip");
+    if (gzipQuality > 0 && gzipQuality >= deflateQuality)
+        pModData->encoding = ENCODING_GZIP;
+    else if (deflateQuality > 0)
+        pModData->encoding = ENCODING_DEFLATE;
+    else
+        return ;
+
+    if (!StartStream(pModData))
+    {
+        pModData->encoding = ENCODING_NONE;
+        return ;
+    }
+
+    pModData->flushEachPart = streamed;
+    respHeaders.SetHeader(HDR_CONTENT_ENCODING, pModData->encoding == ENCODING_GZIP ? "gzip" : "deflate");
+    respHeaders.RemoveHeader(HDR_CONTENT_LENGTH);
+    respHeaders.SetHeader(HDR_TRANSFER_ENCODING, "chunked");
+}
+
+//! Gets the connection's stream ready for a new response
+bool SCompressionModule::StartStream(SCompressionModuleData *pModData)
+{
+    z_stream *pStream = &pModData->zstream;
+    if (pModData->zstreamReady)
+    {
+        if (pModData->zstreamEncoding == pModData->encoding && pModData->zstreamLevel == compressionLevel)
+            return deflateReset(pStream) == Z_OK;
+
+        deflateEnd(pStream);
+        pModData->zstreamReady = false;
+    }
+
+    // gzip wraps the deflate data in a gzip header and trailer
+    int windowBits = zlibWindowBits + (pModData->encoding == ENCODING_GZIP ? 16 : 0);
+    memset(pStream, 0, sizeof(*pStream));
+    int result = deflateInit2(pStream, compressionLevel, Z_DEFLATED, windowBits, zlibMemLevel, Z_DEFAULT_STRATEGY);
+    if (result != Z_OK)
+    {
+        SLogger::Get()->Log("ERROR: deflateInit2 failed [%d]: %s\n", result, pStream->msg ? pStream->msg : "");
+        return false;
+    }
+
+    pModData->zstreamReady      = true;
+    pModData->zstreamEncoding   = pModData->encoding;
+    pModData->zstreamLevel      = compressionLevel;
+    return true;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Feeds data to the compressor and sends on the compressed
+ *  output as raw parts of upto COMPRESSED_PART_SIZE bytes.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+void SCompressionModule::Compress(SConnection *             pConnection,
+                                  SHttpHandlerStage *       pStage,
+                                  SHttpRequest *            pRequest,
+                                  SCompressionModuleData *  pModData,
+                                  const char *              pData,
+                                  size_t                    dataSize,
+                                  int                       flush)
+{
+    SHttpResponse * pResponse   = pRequest->Response();
+    z_stream *      pStream     = &pModData->zstream;
+    SRawBodyPart *  pOutput     = NULL;
+    size_t          outputSize  = 0;
+
+    pStream->next_in    = (Bytef *)pData;
+    pStream->avail_in   = dataSize;
+    while (true)
+    {
+        if (pOutput == NULL)
+        {
+            pOutput     = pResponse->NewInsertedBodyPart();
+            pOutput->data.resize(COMPRESSED_PART_SIZE);
+            outputSize  = 0;
+        }
+
+        pStream->next_out   = (Bytef *)(&pOutput->data[0] + outputSize);
+        pStream->avail_out  = COMPRESSED_PART_SIZE - outputSize;
+        int result          = deflate(pStream, flush);
+        outputSize          = COMPRESSED_PART_SIZE - pStream->avail_out;
+        if (result == Z_STREAM_ERROR)
+        {
+            SLogger::Get()->Log("ERROR: deflate failed: %s\n", pStream->msg ? pStream->msg : "");
+            break ;
+        }
+
+        if (pStream->avail_out != 0)
+            break ;
+
+        // part is full so send it and carry on
+        SendBodyPartToModule(pConnection, pStage, pRequest, pOutput, pModData, pNextModule);
+        pOutput = NULL;
+    }
+
+    if (outputSize > 0)
+    {
+        pOutput->data.resize(outputSize);
+        SendBodyPartToModule(pConnection, pStage, pRequest, pOutput, pModData, pNextModule);
+    }
+    else if (pOutput != NULL)
+    {
+        delete pOutput;
+    }
+}
+
+void SCompressionModule::HandleBodyPart(SConnection *               pConnection,
+                                        SHttpHandlerData *          pHandlerData,
+                                        SHttpHandlerStage *         pStage,
+                                        SCompressionModuleData *    pModData,
+                                        SBodyPart *                 pBodyPart)
+{
+    SHttpRequest *  pRequest    = pHandlerData->Request();
+    int             bpType      = pBodyPart->Type();
+
+    // the connection is already being closed so the rest of the body is
+    // of no use
+    if (pModData->aborted)
+    {
+        delete pBodyPart;
+        return ;
+    }
+
+    if (bpType == SHttpMessage::HTTP_BP_CONTENT_FINISHED)
+    {
+        if (pModData->encoding != ENCODING_NONE)
+        {
+            Compress(pConnection, pStage, pRequest, pModData, NULL, 0, Z_FINISH);
+            pModData->encoding = ENCODING_NONE;
+        }
+        SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
+        return ;
+    }
+    else if (bpType >= SBodyPart::BP_NUM_TYPES)
+    {
+        // sub message and connection markers go on as they are
+        SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
+        return ;
+    }
+
+    if (!pModData->decided)
+        DecideEncoding(pRequest, pModData, pBodyPart);
+
+    if (pModData->encoding == ENCODING_NONE)
+    {
+        SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
+        return ;
+    }
+
+    int flush = pModData->flushEachPart ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+    if (bpType == SBodyPart::BP_RAW)
+    {
+        SRawBodyPart *pRawBodyPart = dynamic_cast<SRawBodyPart *>(pBodyPart);
+        const char *pData = pRawBodyPart->data.empty() ? NULL : &pRawBodyPart->data[0];
+        Compress(pConnection, pStage, pRequest, pModData, pData, pRawBodyPart->Size(), flush);
+    }
+    else if (bpType == SBodyPart::BP_SEGMENTED)
+    {
+        // compress the slices where they are
+        SSegmentedBodyPart *pSegmentedPart = dynamic_cast<SSegmentedBodyPart *>(pBodyPart);
+        const std::deque<SSegmentedBodyPart::Slice> &slices = pSegmentedPart->Slices();
+        for (size_t i = 0;i < slices.size();i++)
+        {
+            int sliceFlush = (i + 1 == slices.size()) ? flush : Z_NO_FLUSH;
+            Compress(pConnection, pStage, pRequest, pModData, slices[i].pData, slices[i].length, sliceFlush);
+        }
+    }
+    else
+    {
+        // file, spooled and lazy parts are only read as the writer gets to
+        // them - compressing them here would read (or pull) them whole on
+        // this thread and queue all of the output at once.  As part of the
+        // body is already out compressed, the response is cut short and the
+        // connection closed so the client sees it is incomplete.
+        SLogger::Get()->Log("ERROR: Cannot compress body part of type %d, closing connection\n", bpType);
+        pModData->aborted = true;
+
+        SRawBodyPart *pCloser = pRequest->Response()->NewInsertedBodyPart();
+        pCloser->bpType = SHttpMessage::HTTP_BP_CLOSE_CONNECTION;
+        SendBodyPartToModule(pConnection, pStage, pRequest, pCloser, pModData, pNextModule);
+    }
+    delete pBodyPart;
+}
+
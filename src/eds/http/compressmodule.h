@@ -0,0 +1,202 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   compressmodule.h
+ *
+ *  \brief  A module that gzip/deflate compresses response bodies.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#ifndef _SCOMPRESSION_MODULE_H_
+#define _SCOMPRESSION_MODULE_H_
+
+#include "httpmodule.h"
+#include <zlib.h>
+
+//*****************************************************************************
+/*!
+ *  \class  SCompressionModuleData
+ *
+ *  \brief  Per connection compression state.
+ *
+ *  The zlib stream is kept for the life of the connection and only reset
+ *  between responses, so its buffers are allocated once per connection.
+ *
+ *****************************************************************************/
+class SCompressionModuleData : public SHttpModuleData
+{
+public:
+    //! Creates the module data
+    SCompressionModuleData();
+
+    //! Frees the zlib stream
+    virtual ~SCompressionModuleData();
+
+    //! Readies the data for a new response
+    virtual void Reset()
+    {
+        SHttpModuleData::Reset();
+        decided     = false;
+        encoding    = 0;
+        aborted     = false;
+    }
+
+public:
+    //! Whether it was decided if the current response is compressed
+    bool        decided;
+
+    //! The encoding of the current response (0 if not compressed)
+    int         encoding;
+
+    //! Whether each part is flushed out as it is compressed (for streamed
+    // responses) instead of when zlib sees fit
+    bool        flushEachPart;
+
+    //! Whether the response was cut short as a part could not be compressed
+    bool        aborted;
+
+    //! The compressor
+    z_stream    zstream;
+
+    //! Whether zstream has been initialised
+    bool        zstreamReady;
+
+    //! The encoding and level zstream was initialised for
+    int         zstreamEncoding;
+    int         zstreamLevel;
+};
+
+//*****************************************************************************
+/*!
+ *  \class  SCompressionModule
+ *
+ *  \brief  Compresses raw body parts with gzip or deflate, whichever the
+ *  client prefers.
+ *
+ *  The module goes before the content module.  Compressed responses lose
+ *  their Content-Length and are sent chunked instead (so a transfer module
+ *  must follow the content module), as the compressed size is only known
+ *  once the last part has been through.  Only responses of the configured
+ *  mime types and of at least the minimum size (going by Content-Length if
+ *  set or else the first part) whose first part is in memory are
+ *  compressed - files (whether sent with sendfile or from memory) are left
+ *  as they are.  If a part that is not in memory follows in a compressed
+ *  response the connection is closed instead, as such parts are only read
+ *  as the writer gets to them.
+ *
+ *****************************************************************************/
+class SCompressionModule : public SHttpModule
+{
+public:
+    //! Encodings the module can produce
+    enum
+    {
+        ENCODING_NONE,
+        ENCODING_GZIP,
+        ENCODING_DEFLATE
+    };
+
+public:
+    //! Creates the module
+    SCompressionModule(SHttpModule *pNext, int level = Z_DEFAULT_COMPRESSION);
+
+    //! Called to handle output data from another module
+    virtual void ProcessOutput(SConnection *        pConnection,
+                               SHttpHandlerData *   pHandlerData,
+                               SHttpHandlerStage *  pStage,
+                               SBodyPart *          pBodyPart);
+
+    //! Creates new module data if necessary
+    virtual SHttpModuleData *CreateModuleData(SHttpHandlerData *pHandlerData)
+    {
+        return new SCompressionModuleData();
+    }
+
+    //! Sets the zlib compression level (0 - 9)
+    void SetLevel(int level) { compressionLevel = level; }
+
+    //! Sets the smallest body that is worth compressing
+    void SetMinSize(size_t size) { minSize = size; }
+
+    //! Sets the zlib window and memory levels.  Each connection's stream
+    // takes about (1 << (windowBits + 2)) + (1 << (memLevel + 9)) bytes.
+    void SetMemoryLevels(int windowBits, int memLevel)
+    {
+        zlibWindowBits  = windowBits;
+        zlibMemLevel    = memLevel;
+    }
+
+    //! Gets the zlib window bits
+    int WindowBits() const { return zlibWindowBits; }
+
+    //! Gets the zlib memory level
+    int MemLevel() const { return zlibMemLevel; }
+
+    //! Adds a mime type (or a prefix ending in '/', eg "text/") to compress
+    void AddMimeType(const SString &mimeType) { mimeTypes.push_back(mimeType); }
+
+    //! Forgets all mime types to compress
+    void ClearMimeTypes() { mimeTypes.clear(); }
+
+    //! Tells how much a client accepts an encoding (-1 if not at all)
+    static int EncodingQuality(const SString &acceptEncoding, const char *encoding);
+
+protected:
+    void HandleBodyPart(SConnection *               pConnection,
+                        SHttpHandlerData *          pHandlerData,
+                        SHttpHandlerStage *         pStage,
+                        SCompressionModuleData *    pModData,
+                        SBodyPart *                 pBodyPart);
+
+    //! Decides whether the response is compressed and fixes its headers
+    void DecideEncoding(SHttpRequest *pRequest, SCompressionModuleData *pModData, SBodyPart *pFirstPart);
+
+    //! Tells if a content type is one to compress
+    bool CompressesMimeType(const SString &contentType) const;
+
+    //! Gets the stream ready for a new response
+    bool StartStream(SCompressionModuleData *pModData);
+
+    //! Compresses data and sends on whatever zlib outputs
+    void Compress(SConnection *             pConnection,
+                  SHttpHandlerStage *       pStage,
+                  SHttpRequest *            pRequest,
+                  SCompressionModuleData *  pModData,
+                  const char *              pData,
+                  size_t                    dataSize,
+                  int                       flush);
+
+protected:
+    //! zlib compression level
+    int                 compressionLevel;
+
+    //! zlib window bits and memory level
+    int                 zlibWindowBits;
+    int                 zlibMemLevel;
+
+    //! Smallest body compressed
+    size_t              minSize;
+
+    //! Mime types that are compressed
+    SStringList         mimeTypes;
+};
+
+#endif
+
@@ -150,19 +150,60 @@ void SContentModule::HandleBodyPart(SConnection *       pConnection,
         // necessary and send to next module
         if ( pResponse->IsMultipart() )
         {
-            assert("Not sure how to send files in multipart" && bpType != SBodyPart::BP_FILE);
-
             // prepend the 'current' boundary and send
             assert("No boundaries found in multi part message" && !pModData->boundaries.empty());
 
-            SRawBodyPart *pRawBodyPart = dynamic_cast<SRawBodyPart *>(pBodyPart);
+            if (bpType == SBodyPart::BP_FILE)
+            {
+                // files cannot be prepended to so the boundary goes
+                // in a part of its own
+                SFileBodyPart * pFileBodyPart = dynamic_cast<SFileBodyPart *>(pBodyPart);
+                SStringStream   boundary;
+                boundary << URLUtils::CRLF << "--" << pModData->boundaries.front() << URLUtils::CRLF;
+                if (!pFileBodyPart->contentType.empty())
+                    boundary << "Content-Type: " << pFileBodyPart->contentType << URLUtils::CRLF;
+                if (pFileBodyPart->IsRange())
+                {
+                    boundary << "Content-Range: bytes " << pFileBodyPart->RangeStart() << "-"
+                             << (pFileBodyPart->RangeStart() + pFileBodyPart->Size() - 1) << "/"
+                             << pFileBodyPart->FileSize() << URLUtils::CRLF;
+                }
+                boundary << "Content-Length: " << pFileBodyPart->Size() << URLUtils::CRLF << URLUtils::CRLF;
+
+                SRawBodyPart *pBoundaryPart = pResponse->NewInsertedBodyPart();
+                pBoundaryPart->SetBody(boundary.str());
+                SendBodyPartToModule(pConnection, pStage, pRequest, pBoundaryPart, pModData, pNextModule);
+                SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
+                return ;
+            }
 
             SStringStream boundary;
             boundary << URLUtils::CRLF << "--" << pModData->boundaries.front() << URLUtils::CRLF;
             // boundary << "Content-Type: " << "text/text" << URLUtils::CRLF;
-            boundary << "Content-Length: " << pRawBodyPart->Size() << URLUtils::CRLF << URLUtils::CRLF;
 
-            pRawBodyPart->InsertInBody(boundary.str());
+            if (bpType == SBodyPart::BP_SEGMENTED)
+            {
+                // segmented parts take the boundary in front without
+                // moving their data
+                SSegmentedBodyPart *pSegmentedPart = dynamic_cast<SSegmentedBodyPart *>(pBodyPart);
+                boundary << "Content-Length: " << pSegmentedPart->Size() << URLUtils::CRLF << URLUtils::CRLF;
+                pSegmentedPart->Prepend(boundary.str());
+            }
+            else
+            {
+                // the boundary goes ahead in a part of its own instead of
+                // shifting all of the part's data up to make room for it
+                long long partSize = bpType == SBodyPart::BP_LAZY ?
+                                        dynamic_cast<SLazyBodyPart *>(pBodyPart)->Size() :
+                                        dynamic_cast<SRawBodyPart *>(pBodyPart)->Size();
+                if (partSize >= 0)
+                    boundary << "Content-Length: " << partSize << URLUtils::CRLF;
+                boundary << URLUtils::CRLF;
+
+                SRawBodyPart *pBoundaryPart = pResponse->NewInsertedBodyPart();
+                pBoundaryPart->SetBody(boundary.str());
+                SendBodyPartToModule(pConnection, pStage, pRequest, pBoundaryPart, pModData, pNextModule);
+            }
 
             SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
         }
@@ -171,12 +212,25 @@ void SContentModule::HandleBodyPart(SConnection *       pConnection,
             // TODO: take care of content encoding
 
             SHeaderTable &  respHeaders     = pResponse->Headers();
-            int             bodySize        = 0;
+            long long       bodySize        = 0;
             if (bpType == SBodyPart::BP_FILE)
             {
                 SFileBodyPart *  pFileBodyPart    = dynamic_cast<SFileBodyPart *>(pBodyPart);
                 bodySize    = pFileBodyPart->Size();
             }
+            else if (bpType == SBodyPart::BP_SEGMENTED)
+            {
+                SSegmentedBodyPart *pSegmentedPart = dynamic_cast<SSegmentedBodyPart *>(pBodyPart);
+                bodySize    = pSegmentedPart->Size();
+            }
+            else if (bpType == SBodyPart::BP_LAZY)
+            {
+                // parts of unknown size have to be sent chunked
+                SLazyBodyPart * pLazyBodyPart   = dynamic_cast<SLazyBodyPart *>(pBodyPart);
+                bodySize    = pLazyBodyPart->Size();
+                if (bodySize < 0 && !respHeaders.HasHeader(HDR_CONTENT_LENGTH))
+                    respHeaders.SetHeader(HDR_TRANSFER_ENCODING, "chunked");
+            }
             else
             {
                 SRawBodyPart *  pRawBodyPart    = dynamic_cast<SRawBodyPart *>(pBodyPart);
@@ -184,22 +238,13 @@ void SContentModule::HandleBodyPart(SConnection *       pConnection,
             }
 
             // append to body (can ignore sub messages as it is single part)
-            if (bodySize > 0)
+            // - chunked bodies carry their sizes in the chunks instead
+            // - a Content-Length already set by the module that knows the
+            // whole body (which can be past 2GB) is kept as is
+            if (bodySize > 0 && !respHeaders.HasHeader(HDR_TRANSFER_ENCODING) &&
+                !respHeaders.HasHeader(HDR_CONTENT_LENGTH))
             {
-                int contLength = -1;
-                SString hdrContLength;
-                if (respHeaders.HeaderIfExists("Content-Length", hdrContLength))
-                {
-                    contLength  = atoi(hdrContLength.c_str());
-                }
-
-                // For now set the contlength header to be what ever
-                // the body size is and not worry about caching.  The
-                // application or lower layers MUST do the caching.
-                if (bodySize != contLength)
-                {
-                    respHeaders.SetIntHeader("Content-Length", bodySize);
-                }
+                respHeaders.SetContentLength(bodySize);
             }
 
             SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
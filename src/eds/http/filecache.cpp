@@ -0,0 +1,547 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   filecache.cpp
+ *
+ *  \brief  A cache of the stat results, mime types and open descriptors
+ *  of static files.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include "filecache.h"
+#include "eds/utils.h"
+#include "eds/sharedfile.h"
+#include "eds/sharedbuffer.h"
+#include "utils/mimetypes.h"
+
+#include <unistd.h>
+#include <sys/inotify.h>
+
+//! Content-Encoding of each precompressed copy
+const char *SFileCacheEntry::VARIANT_ENCODINGS[NUM_VARIANTS]   = { "br", "gzip" };
+
+//! What is added to a file's name to get each precompressed copy
+const char *SFileCacheEntry::VARIANT_EXTENSIONS[NUM_VARIANTS]  = { ".br", ".gz" };
+
+//! Changes to a watched folder that invalidate entries
+static const uint32_t WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE |
+                                   IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                   IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+//! Gets the folder a file is in
+static SString DirectoryOf(const SString &path)
+{
+    size_t slashPos = path.rfind('/');
+    if (slashPos == SString::npos)
+        return ".";
+    else if (slashPos == 0)
+        return "/";
+    return path.substr(0, slashPos);
+}
+
+//! Creates an empty entry
+SFileCacheEntry::SFileCacheEntry(const SString &filePath) :
+    path(filePath),
+    directory(DirectoryOf(filePath)),
+    pFile(NULL),
+    pContents(NULL),
+    refCount(1)
+{
+    memset(&fileStat, 0, sizeof(fileStat));
+    for (int i = 0;i < NUM_VARIANTS;i++)
+    {
+        pVariants[i]        = NULL;
+        variantSizes[i]     = 0;
+        pVariantContents[i] = NULL;
+    }
+}
+
+//! Closes the files
+SFileCacheEntry::~SFileCacheEntry()
+{
+    if (pFile != NULL)
+        pFile->DecRef();
+    if (pContents != NULL)
+        pContents->DecRef();
+    for (int i = 0;i < NUM_VARIANTS;i++)
+    {
+        if (pVariants[i] != NULL)
+            pVariants[i]->DecRef();
+        if (pVariantContents[i] != NULL)
+            pVariantContents[i]->DecRef();
+    }
+}
+
+//! Reads all of an open file into a shared buffer (NULL on errors)
+static SSharedBuffer *ReadContents(SSharedFile *pFile, size_t size)
+{
+    SCharVector data(size);
+    size_t      numRead = 0;
+    while (numRead < size)
+    {
+        ssize_t result = pread(pFile->FD(), &data[numRead], size - numRead, numRead);
+        if (result <= 0)
+            return NULL;
+        numRead += result;
+    }
+    return SSharedBuffer::Create(&data[0], size);
+}
+
+//! Reads the file and its precompressed copies into memory if they are no
+// larger than maxSize.  Empty files are left to go out as file parts.
+void SFileCacheEntry::LoadContents(size_t maxSize)
+{
+    if (pFile != NULL && fileStat.st_size > 0 && (size_t)fileStat.st_size <= maxSize)
+        pContents = ReadContents(pFile, fileStat.st_size);
+    for (int i = 0;i < NUM_VARIANTS;i++)
+    {
+        if (pVariants[i] != NULL && variantSizes[i] > 0 && (size_t)variantSizes[i] <= maxSize)
+            pVariantContents[i] = ReadContents(pVariants[i], variantSizes[i]);
+    }
+}
+
+//! Bytes of file contents held in memory
+size_t SFileCacheEntry::ContentBytes() const
+{
+    size_t numBytes = pContents == NULL ? 0 : pContents->Size();
+    for (int i = 0;i < NUM_VARIANTS;i++)
+    {
+        if (pVariantContents[i] != NULL)
+            numBytes += pVariantContents[i]->Size();
+    }
+    return numBytes;
+}
+
+//! Drops a reference, deleting the entry with the last one
+void SFileCacheEntry::DecRef()
+{
+    if (__sync_sub_and_fetch(&refCount, 1) == 0)
+        delete this;
+}
+
+//! Makes a strong ETag from a file's inode, size and modification time
+SString SFileCacheEntry::MakeETag(const struct stat &fileStat)
+{
+    char etag[96];
+    snprintf(etag, sizeof(etag), "\"%llx-%llx-%llx.%lx\"",
+             (unsigned long long)fileStat.st_ino, (unsigned long long)fileStat.st_size,
+             (unsigned long long)fileStat.st_mtim.tv_sec, (long)fileStat.st_mtim.tv_nsec);
+    return etag;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Stats a file and for regular files opens it and looks for
+ *  precompressed copies of it.
+ *
+ *  Copies older than the file are ignored as stale.  Returns NULL with
+ *  errno set if the file itself cannot be stat'ed.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+SFileCacheEntry *SFileCacheEntry::Load(const SString &path)
+{
+    SFileCacheEntry *pEntry = new SFileCacheEntry(path);
+    if (stat(path.c_str(), &pEntry->fileStat) != 0)
+    {
+        int errnum = errno;
+        pEntry->DecRef();
+        errno = errnum;
+        return NULL;
+    }
+    if (!S_ISREG(pEntry->fileStat.st_mode))
+        return pEntry;
+
+    pEntry->mimeType    = SMimeTypes::GetInstance()->GetMimeType(path);
+    pEntry->etag        = MakeETag(pEntry->fileStat);
+    pEntry->pFile       = SSharedFile::Open(path);
+
+    for (int i = 0;i < NUM_VARIANTS;i++)
+    {
+        SString     variantPath(path + VARIANT_EXTENSIONS[i]);
+        struct stat variantStat;
+        if (stat(variantPath.c_str(), &variantStat) == 0 &&
+            S_ISREG(variantStat.st_mode) &&
+            variantStat.st_mtime >= pEntry->fileStat.st_mtime &&
+            (pEntry->pVariants[i] = SSharedFile::Open(variantPath)) != NULL)
+        {
+            pEntry->variantSizes[i] = variantStat.st_size;
+        }
+    }
+    return pEntry;
+}
+
+//! Creates the cache
+SFileCache::SFileCache(size_t maxEntries_) :
+    maxEntries(maxEntries_),
+    maxContentFileSize(0),
+    maxContentBytes(0),
+    inotifyFD(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+    checkMsecs(DEFAULT_CHECK_MSECS)
+{
+    memset(&stats, 0, sizeof(stats));
+    memset(&lastCheck, 0, sizeof(lastCheck));
+    if (inotifyFD < 0)
+    {
+        SLogger::Get()->Log("ERROR: inotify not available, files will not be cached, Error [%d]: %s\n",
+                            errno, strerror(errno));
+    }
+}
+
+//! Drops all entries and stops watching
+SFileCache::~SFileCache()
+{
+    Clear();
+    if (inotifyFD >= 0)
+        close(inotifyFD);
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Gets the entry for a file, loading it if it is not cached or
+ *  has changed.
+ *
+ *  The caller gets its own reference to the entry and must drop it.
+ *  Entries of files that are not cached (eg folders) are only referenced
+ *  by the caller.  Returns NULL with errno set if the file cannot be
+ *  stat'ed.
+ *
+ *  The folder is watched before the file is looked at so that a change
+ *  made while it is being loaded is not missed.  The file is loaded
+ *  without holding the lock (so a slow disk does not hold up lookups of
+ *  other files) and is only cached if nothing changed in the meantime.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+SFileCacheEntry *SFileCache::Get(const SString &path)
+{
+    SString directory(DirectoryOf(path));
+    size_t  contentFileSize = 0;
+    size_t  contentBytes    = 0;
+    int     wd              = -1;
+
+    cacheMutex.Lock();
+    CheckEvents();
+
+    EntryMap::iterator iter = entries.find(path);
+    if (iter != entries.end())
+    {
+        stats.numHits++;
+        lruList.splice(lruList.begin(), lruList, iter->second);
+        SFileCacheEntry *pEntry = *iter->second;
+        if (pEntry->pContents != NULL)
+            stats.numContentHits++;
+        pEntry->IncRef();
+        cacheMutex.Unlock();
+        return pEntry;
+    }
+
+    stats.numMisses++;
+    if (maxEntries > 0 && inotifyFD >= 0 && WatchDirectory(directory))
+    {
+        wd                  = dirWatches[directory].first;
+        contentFileSize     = maxContentFileSize;
+        contentBytes        = std::min(maxContentFileSize, maxContentBytes);
+        PendingLoad &load   = pendingLoads[path];
+        if (load.numLoaders++ == 0)
+            load.changed = false;
+    }
+    cacheMutex.Unlock();
+
+    SFileCacheEntry *pEntry = SFileCacheEntry::Load(path);
+    if (wd < 0)
+    {
+        // changes to it could not be noticed so leave it out
+        return pEntry;
+    }
+    else if (pEntry != NULL && pEntry->pFile != NULL && contentFileSize > 0 &&
+             (size_t)pEntry->fileStat.st_size <= contentFileSize)
+    {
+        pEntry->LoadContents(contentBytes);
+    }
+
+    SMutexLock locker(cacheMutex);
+
+    // see if anything changed while the file was being loaded
+    ReadEvents();
+    PendingLoadMap::iterator loadIter = pendingLoads.find(path);
+    bool changed = loadIter->second.changed;
+    if (--loadIter->second.numLoaders == 0)
+        pendingLoads.erase(loadIter);
+
+    if (pEntry == NULL || pEntry->pFile == NULL || changed || entries.find(path) != entries.end())
+    {
+        // left out (or another lookup cached it first) so give back its
+        // count on the watch - unless the watch has since been replaced
+        std::map<SString, DirWatch>::iterator watchIter = dirWatches.find(directory);
+        if (watchIter != dirWatches.end() && watchIter->second.first == wd)
+            UnwatchDirectory(directory);
+        return pEntry;
+    }
+
+    size_t contentSize = pEntry->ContentBytes();
+    while (!lruList.empty() && (entries.size() >= maxEntries ||
+                                stats.contentBytes + contentSize > maxContentBytes))
+    {
+        stats.numEvicted++;
+        Remove(entries.find(lruList.back()->path));
+    }
+
+    lruList.push_front(pEntry);
+    entries[path]       = lruList.begin();
+    stats.contentBytes += contentSize;
+    pEntry->IncRef();
+    return pEntry;
+}
+
+//! Drops all entries
+void SFileCache::Clear()
+{
+    SMutexLock locker(cacheMutex);
+    while (!entries.empty())
+        Remove(entries.begin());
+}
+
+//! Sets the most entries kept
+void SFileCache::SetMaxEntries(size_t maxEntries_)
+{
+    SMutexLock locker(cacheMutex);
+    maxEntries = maxEntries_;
+    while (entries.size() > maxEntries)
+    {
+        stats.numEvicted++;
+        Remove(entries.find(lruList.back()->path));
+    }
+}
+
+//! Keeps the contents of files upto a size in memory within a total
+void SFileCache::SetContentLimits(size_t maxFileSize, size_t maxTotalBytes)
+{
+    SMutexLock locker(cacheMutex);
+    maxContentFileSize  = maxFileSize;
+    maxContentBytes     = maxTotalBytes;
+    while (!lruList.empty() && stats.contentBytes > maxContentBytes)
+    {
+        stats.numEvicted++;
+        Remove(entries.find(lruList.back()->path));
+    }
+}
+
+//! Gets a copy of the lookup counts
+SFileCache::Stats SFileCache::GetStats()
+{
+    SMutexLock locker(cacheMutex);
+    return stats;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Reads the pending inotify events (if the check interval has
+ *  passed) and drops the entries of files that changed.
+ *
+ *  A change to a precompressed copy drops the file it is a copy of.  If
+ *  a watched folder itself goes away or events were lost, all the
+ *  affected entries are dropped.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+void SFileCache::CheckEvents()
+{
+    if (inotifyFD < 0 || dirWatches.empty())
+        return ;
+
+    if (checkMsecs > 0)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        long elapsed = (now.tv_sec - lastCheck.tv_sec) * 1000 + (now.tv_nsec - lastCheck.tv_nsec) / 1000000;
+        if (elapsed < checkMsecs)
+            return ;
+        lastCheck = now;
+    }
+    ReadEvents();
+}
+
+//! Reads pending inotify events and drops the entries they affect
+void SFileCache::ReadEvents()
+{
+    if (inotifyFD < 0 || dirWatches.empty())
+        return ;
+
+    char    buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t numRead;
+    while ((numRead = read(inotifyFD, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *pCurr = buffer;pCurr < buffer + numRead;)
+        {
+            struct inotify_event *pEvent = (struct inotify_event *)pCurr;
+            pCurr += sizeof(struct inotify_event) + pEvent->len;
+
+            if (pEvent->mask & IN_Q_OVERFLOW)
+            {
+                SLogger::Get()->Log("DEBUG: inotify queue overflowed, dropping all cached files\n");
+                stats.numInvalidated += entries.size();
+                while (!entries.empty())
+                    Remove(entries.begin());
+                ChangedWhileLoading(NULL);
+                continue ;
+            }
+
+            std::map<int, SString>::iterator dirIter = watchedDirs.find(pEvent->wd);
+            if (dirIter == watchedDirs.end())
+                continue ;
+
+            SString directory(dirIter->second);
+            if (pEvent->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                InvalidateDirectory(directory);
+            }
+            else if (pEvent->len > 0)
+            {
+                SString path(directory == "/" ? "/" : directory + "/");
+                path += pEvent->name;
+                Invalidate(path);
+                for (int i = 0;i < SFileCacheEntry::NUM_VARIANTS;i++)
+                {
+                    size_t extLength = strlen(SFileCacheEntry::VARIANT_EXTENSIONS[i]);
+                    if (path.size() > extLength &&
+                        path.compare(path.size() - extLength, extLength, SFileCacheEntry::VARIANT_EXTENSIONS[i]) == 0)
+                    {
+                        Invalidate(path.substr(0, path.size() - extLength));
+                    }
+                }
+            }
+        }
+    }
+}
+
+//! Drops the entry of a file if there is one
+void SFileCache::Invalidate(const SString &path)
+{
+    EntryMap::iterator iter = entries.find(path);
+    if (iter != entries.end())
+    {
+        stats.numInvalidated++;
+        Remove(iter);
+    }
+
+    PendingLoadMap::iterator loadIter = pendingLoads.find(path);
+    if (loadIter != pendingLoads.end())
+        loadIter->second.changed = true;
+}
+
+//! Notes that files being loaded (in a folder or all of them) have changed
+void SFileCache::ChangedWhileLoading(const SString *directory)
+{
+    for (PendingLoadMap::iterator iter = pendingLoads.begin();iter != pendingLoads.end();++iter)
+    {
+        if (directory == NULL || DirectoryOf(iter->first) == *directory)
+            iter->second.changed = true;
+    }
+}
+
+//! Drops the entries of all the files in a folder
+void SFileCache::InvalidateDirectory(const SString &directory)
+{
+    EntryMap::iterator iter = entries.begin();
+    while (iter != entries.end())
+    {
+        EntryMap::iterator next = iter;
+        ++next;
+        if ((*iter->second)->directory == directory)
+        {
+            stats.numInvalidated++;
+            Remove(iter);
+        }
+        iter = next;
+    }
+    ChangedWhileLoading(&directory);
+
+    // the watch may be gone already
+    std::map<SString, DirWatch>::iterator watchIter = dirWatches.find(directory);
+    if (watchIter != dirWatches.end())
+    {
+        inotify_rm_watch(inotifyFD, watchIter->second.first);
+        watchedDirs.erase(watchIter->second.first);
+        dirWatches.erase(watchIter);
+    }
+}
+
+//! Drops an entry
+void SFileCache::Remove(EntryMap::iterator iter)
+{
+    SFileCacheEntry *pEntry = *iter->second;
+    lruList.erase(iter->second);
+    entries.erase(iter);
+    stats.contentBytes -= pEntry->ContentBytes();
+    UnwatchDirectory(pEntry->directory);
+    pEntry->DecRef();
+}
+
+//! Starts watching a folder (or counts another file in it)
+bool SFileCache::WatchDirectory(const SString &directory)
+{
+    std::map<SString, DirWatch>::iterator iter = dirWatches.find(directory);
+    if (iter != dirWatches.end())
+    {
+        iter->second.second++;
+        return true;
+    }
+
+    int wd = inotify_add_watch(inotifyFD, directory.c_str(), WATCH_MASK);
+    if (wd < 0)
+    {
+        SLogger::Get()->Log("ERROR: Could not watch folder: %s, Error [%d]: %s\n",
+                            directory.c_str(), errno, strerror(errno));
+        return false;
+    }
+    else if (watchedDirs.find(wd) != watchedDirs.end())
+    {
+        // the same folder by another path - leave the files out rather
+        // than have two paths share (and unwatch) one watch
+        return false;
+    }
+
+    dirWatches[directory]   = DirWatch(wd, 1);
+    watchedDirs[wd]         = directory;
+    return true;
+}
+
+//! Stops watching a folder once none of its files are cached
+void SFileCache::UnwatchDirectory(const SString &directory)
+{
+    std::map<SString, DirWatch>::iterator iter = dirWatches.find(directory);
+    if (iter != dirWatches.end() && --iter->second.second == 0)
+    {
+        inotify_rm_watch(inotifyFD, iter->second.first);
+        watchedDirs.erase(iter->second.first);
+        dirWatches.erase(iter);
+    }
+}
+
@@ -0,0 +1,279 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   filecache.h
+ *
+ *  \brief  A cache of the stat results, mime types and open descriptors
+ *  of static files.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#ifndef _SFILE_CACHE_H_
+#define _SFILE_CACHE_H_
+
+#include "eds/fwd.h"
+#include "thread/mutex.h"
+#include <sys/stat.h>
+#include <time.h>
+
+class SSharedFile;
+class SSharedBuffer;
+
+//*****************************************************************************
+/*!
+ *  \class  SFileCacheEntry
+ *
+ *  \brief  What is known about a file - never changed once loaded.
+ *
+ *  Entries are reference counted as responses may still be sending from
+ *  an entry's files after it has been dropped from the cache.
+ *
+ *****************************************************************************/
+class SFileCacheEntry
+{
+public:
+    //! Precompressed copies of a file that are looked for
+    enum
+    {
+        VARIANT_BROTLI,
+        VARIANT_GZIP,
+        NUM_VARIANTS
+    };
+
+    //! Content-Encoding of each precompressed copy
+    static const char *VARIANT_ENCODINGS[NUM_VARIANTS];
+
+    //! What is added to a file's name to get each precompressed copy
+    static const char *VARIANT_EXTENSIONS[NUM_VARIANTS];
+
+public:
+    //! Stats (and for regular files opens) a file and its precompressed
+    // copies.  Returns NULL with errno set if the file cannot be stat'ed.
+    static SFileCacheEntry *Load(const SString &path);
+
+    //! Makes a strong ETag from a file's inode, size and modification time
+    static SString MakeETag(const struct stat &fileStat);
+
+    //! Reads the file and its precompressed copies into memory if they
+    // are no larger than maxSize.  Only called before the entry is
+    // shared.
+    void LoadContents(size_t maxSize);
+
+    //! Bytes of file contents held in memory
+    size_t ContentBytes() const;
+
+    //! Adds a reference
+    inline void IncRef() { __sync_add_and_fetch(&refCount, 1); }
+
+    //! Drops a reference, deleting the entry with the last one
+    void DecRef();
+
+public:
+    //! Path of the file
+    SString         path;
+
+    //! Folder the file is in
+    SString         directory;
+
+    //! The file's stat
+    struct stat     fileStat;
+
+    //! Mime type going by the file's extension
+    SString         mimeType;
+
+    //! ETag of the file
+    SString         etag;
+
+    //! The open file (NULL if it is not a regular file or could not be
+    // opened)
+    SSharedFile *   pFile;
+
+    //! Open precompressed copies that are newer than the file (NULL if
+    // there is none) and their sizes
+    SSharedFile *   pVariants[NUM_VARIANTS];
+    off_t           variantSizes[NUM_VARIANTS];
+
+    //! Contents of the file and its precompressed copies if they are
+    // small enough to be kept in memory (NULL otherwise)
+    SSharedBuffer * pContents;
+    SSharedBuffer * pVariantContents[NUM_VARIANTS];
+
+private:
+    //! Only created by Load
+    SFileCacheEntry(const SString &filePath);
+
+    //! Closes the files
+    ~SFileCacheEntry();
+
+    //! Not copyable
+    SFileCacheEntry(const SFileCacheEntry &);
+    SFileCacheEntry &operator=(const SFileCacheEntry &);
+
+private:
+    //! Number of references
+    volatile unsigned   refCount;
+};
+
+//*****************************************************************************
+/*!
+ *  \class  SFileCache
+ *
+ *  \brief  Keeps the entries of the most recently requested files so they
+ *  can be served without stat'ing and opening them each time.
+ *
+ *  Entries are dropped when anything changes in their folder - each
+ *  folder with cached files is watched with inotify and the events are
+ *  read at most once every check interval (so a change may go unnoticed
+ *  for that long).  Only regular files are cached and only while inotify
+ *  is available.  The least recently used entry is evicted once there are
+ *  more than the maximum number of entries (each holds upto three open
+ *  descriptors).
+ *
+ *  Optionally the contents of small files are kept in memory too, so hot
+ *  files can be sent along with their headers in one write instead of
+ *  with a sendfile each time.  Least recently used entries are then also
+ *  evicted to keep the contents within a byte limit.
+ *
+ *****************************************************************************/
+class SFileCache
+{
+public:
+    //! Default limits
+    static const size_t DEFAULT_MAX_ENTRIES = 1024;
+    static const int    DEFAULT_CHECK_MSECS = 50;
+
+    //! Lookup counts
+    struct Stats
+    {
+        size_t  numHits;            // lookups served from the cache
+        size_t  numMisses;          // lookups that had to load the file
+        size_t  numInvalidated;     // entries dropped as their file changed
+        size_t  numEvicted;         // entries dropped to make room
+        size_t  numContentHits;     // hits on entries with their contents
+        size_t  contentBytes;       // bytes of file contents held
+    };
+
+public:
+    //! Creates the cache
+    SFileCache(size_t maxEntries = DEFAULT_MAX_ENTRIES);
+
+    //! Drops all entries and stops watching
+    virtual ~SFileCache();
+
+    //! Gets the entry for a file with a reference that the caller must
+    // drop.  Returns NULL with errno set if the file cannot be stat'ed.
+    SFileCacheEntry *Get(const SString &path);
+
+    //! Drops all entries
+    void Clear();
+
+    //! Sets the most entries kept
+    void SetMaxEntries(size_t maxEntries);
+
+    //! Sets how often inotify events are read (0 for on every lookup)
+    void SetCheckInterval(int msecs) { checkMsecs = msecs; }
+
+    //! Keeps the contents of files of upto maxFileSize bytes in memory
+    // while they take no more than maxTotalBytes in all (0 to not keep
+    // contents)
+    void SetContentLimits(size_t maxFileSize, size_t maxTotalBytes);
+
+    //! Gets a copy of the lookup counts
+    Stats GetStats();
+
+protected:
+    //! Most recently used first
+    typedef std::list<SFileCacheEntry *>                EntryList;
+    typedef std::map<SString, EntryList::iterator>      EntryMap;
+
+    //! A watched folder and the number of its cached files
+    typedef std::pair<int, size_t>                      DirWatch;
+
+    //! A file being loaded outside the lock - the number of lookups
+    // loading it and whether it changed while they were
+    struct PendingLoad
+    {
+        int     numLoaders;
+        bool    changed;
+    };
+    typedef std::map<SString, PendingLoad>              PendingLoadMap;
+
+    //! Reads pending inotify events (once the check interval has passed)
+    void CheckEvents();
+
+    //! Reads pending inotify events and drops the entries they affect
+    void ReadEvents();
+
+    //! Drops the entry of a file if there is one
+    void Invalidate(const SString &path);
+
+    //! Notes that files being loaded have changed - all of them if
+    // directory is NULL
+    void ChangedWhileLoading(const SString *directory);
+
+    //! Drops the entries of all the files in a folder
+    void InvalidateDirectory(const SString &directory);
+
+    //! Drops an entry
+    void Remove(EntryMap::iterator iter);
+
+    //! Starts watching a folder (or counts another file in it)
+    bool WatchDirectory(const SString &directory);
+
+    //! Stops watching a folder once none of its files are cached
+    void UnwatchDirectory(const SString &directory);
+
+protected:
+    //! Guards everything below - files are looked up by handler threads
+    SMutex                      cacheMutex;
+
+    //! Entries by path
+    EntryMap                    entries;
+
+    //! Entries in the order they were used
+    EntryList                   lruList;
+
+    //! Most entries kept
+    size_t                      maxEntries;
+
+    //! Largest file and most bytes in all whose contents are kept
+    size_t                      maxContentFileSize;
+    size_t                      maxContentBytes;
+
+    //! The inotify instance (-1 if not available)
+    int                         inotifyFD;
+
+    //! Watched folders by path and by watch descriptor
+    std::map<SString, DirWatch> dirWatches;
+    std::map<int, SString>      watchedDirs;
+
+    //! Files being loaded
+    PendingLoadMap              pendingLoads;
+
+    //! How often and when events were last read
+    int                         checkMsecs;
+    struct timespec             lastCheck;
+
+    //! Lookup counts
+    Stats                       stats;
+};
+
+#endif
+
@@ -27,10 +27,16 @@
 #include <dirent.h>
 #include "utils/dirutils.h"
 #include "filemodule.h"
+#include "compressmodule.h"
 #include "handlerstage.h"
 #include "request.h"
 #include "response.h"
 #include "utils/mimetypes.h"
+#include "eds/sharedfile.h"
+#include "eds/sharedbuffer.h"
+
+//! Most ranges served in one response
+const size_t SFileModule::MAX_RANGES = 16;
 
 //! Called to handle input data from another module
 // This module simply writes out a given file and calls "ProcessOutput of
@@ -61,10 +67,16 @@ void SFileModule::ProcessInput(SConnection *        pConnection,
     }
     else
     {
-        SString fullpath = docroot + filename;
-        struct stat fileStat;
+        SString             fullpath    = docroot + filename;
+        SFileCacheEntry *   pEntry      = NULL;
+        struct stat         fileStat;
         memset(&fileStat, 0, sizeof(struct stat));
-        if (stat(fullpath.c_str(), &fileStat) != 0)
+        if (pFileCache != NULL && (pEntry = pFileCache->Get(fullpath)) != NULL)
+        {
+            fileStat = pEntry->fileStat;
+        }
+
+        if (pEntry == NULL && (pFileCache != NULL || stat(fullpath.c_str(), &fileStat) != 0))
         {
             int statcode    = 500;
             int errnum      = errno;
@@ -113,7 +125,7 @@ void SFileModule::ProcessInput(SConnection *        pConnection,
         }
         else
         {
-            if ((fileStat.st_mode & S_IFDIR) != 0)
+            if (S_ISDIR(fileStat.st_mode))
             {
                 if (showIndexes)
                 {
@@ -135,10 +147,14 @@ void SFileModule::ProcessInput(SConnection *        pConnection,
             {
                 // SendFile(fullpath, fileStat, part, pResponse, respHeaders);
                 // respHeaders.SetIntHeader("Content-Length", fileStat.st_size);
-                respHeaders.SetHeader("Content-Type", SMimeTypes::GetInstance()->GetMimeType(fullpath));
-                part = pResponse->NewFileBodyPart(fullpath);
+                SendFileParts(pConnection, pStage, pRequest, fullpath, fileStat, pEntry);
+                if (pEntry != NULL)
+                    pEntry->DecRef();
+                return ;
             }
         }
+        if (pEntry != NULL)
+            pEntry->DecRef();
     }
 
     pStage->SendEvent_OutputToModule(pConnection, pNextModule, part);
@@ -146,6 +162,449 @@ void SFileModule::ProcessInput(SConnection *        pConnection,
                            pResponse->NewContFinishedPart(pNextModule));
 }
 
+//*****************************************************************************
+/*!
+ *  \brief  Sends a file - or a precompressed copy of it or the ranges of
+ *  either that were asked for - followed by the end of content.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+void SFileModule::SendFileParts(SConnection *       pConnection,
+                                SHttpHandlerStage * pStage,
+                                SHttpRequest *      pRequest,
+                                const SString &     fullpath,
+                                const struct stat & fileStat,
+                                SFileCacheEntry *   pEntry)
+{
+    SHttpResponse * pResponse   = pRequest->Response();
+    SHeaderTable &  respHeaders = pResponse->Headers();
+    SString         contentType = pEntry != NULL ? pEntry->mimeType :
+                                    SMimeTypes::GetInstance()->GetMimeType(fullpath);
+    SString         sendPath(fullpath);
+    off_t           sendSize    = fileStat.st_size;
+    SSharedFile *   pSendFile   = pEntry != NULL ? pEntry->pFile : NULL;
+    SSharedBuffer * pContents   = pEntry != NULL ? pEntry->pContents : NULL;
+    SString         etag        = pEntry != NULL ? pEntry->etag : SFileCacheEntry::MakeETag(fileStat);
+
+    respHeaders.SetHeader(HDR_CONTENT_TYPE, contentType);
+
+    // send a precompressed copy instead if there is one
+    SString     variantPath;
+    const char *encoding    = NULL;
+    bool        hasVariants = false;
+    struct stat variantStat;
+    if (servePrecompressed && pEntry != NULL)
+    {
+        bool available[SFileCacheEntry::NUM_VARIANTS];
+        for (int i = 0;i < SFileCacheEntry::NUM_VARIANTS;i++)
+        {
+            available[i] = pEntry->pVariants[i] != NULL;
+            hasVariants  = hasVariants || available[i];
+        }
+
+        int variant = ChoosePrecompressed(pRequest, available);
+        if (variant >= 0)
+        {
+            sendPath    = fullpath + SFileCacheEntry::VARIANT_EXTENSIONS[variant];
+            sendSize    = pEntry->variantSizes[variant];
+            pSendFile   = pEntry->pVariants[variant];
+            pContents   = pEntry->pVariantContents[variant];
+            encoding    = SFileCacheEntry::VARIANT_ENCODINGS[variant];
+            respHeaders.SetHeader(HDR_CONTENT_ENCODING, encoding);
+        }
+    }
+    else if (servePrecompressed &&
+             FindPrecompressed(fullpath, fileStat, pRequest, variantPath, encoding, hasVariants) &&
+             stat(variantPath.c_str(), &variantStat) == 0)
+    {
+        sendPath    = variantPath;
+        sendSize    = variantStat.st_size;
+        respHeaders.SetHeader(HDR_CONTENT_ENCODING, encoding);
+    }
+    if (hasVariants)
+        respHeaders.SetHeader(HDR_VARY, "Accept-Encoding");
+
+    SendRepresentation(pConnection, pStage, pRequest, sendPath, pSendFile, 0, sendSize,
+                       pContents, contentType, EncodedETag(etag, encoding), fileStat.st_mtime);
+}
+
+//! Gets the ETag of a file's copy with the given encoding - each encoding
+// is a different representation so needs its own tag
+SString SFileModule::EncodedETag(const SString &etag, const char *encoding)
+{
+    SString encodedTag(etag);
+    if (encoding != NULL && encodedTag.size() > 1)
+        encodedTag.insert(encodedTag.size() - 1, SString("-") + encoding);
+    return encodedTag;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Sends the chosen copy of a file - the whole of it, the ranges
+ *  that were asked for or just a 304 if the client's copy is current -
+ *  followed by the end of content.
+ *
+ *  The copy is sent from pContents if it is held in memory, otherwise
+ *  from pSendFile (where it starts at fileOffset) if it is open and from
+ *  sendPath if not.  Content-Type, Content-Encoding and Vary must already
+ *  be set.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+void SFileModule::SendRepresentation(SConnection *          pConnection,
+                                     SHttpHandlerStage *    pStage,
+                                     SHttpRequest *         pRequest,
+                                     const SString &        sendPath,
+                                     SSharedFile *          pSendFile,
+                                     off_t                  fileOffset,
+                                     off_t                  sendSize,
+                                     SSharedBuffer *        pContents,
+                                     const SString &        contentType,
+                                     const SString &        etag,
+                                     time_t                 lastModifiedTime)
+{
+    SHttpResponse * pResponse   = pRequest->Response();
+    SHeaderTable &  respHeaders = pResponse->Headers();
+
+    SString lastModified = SHttpResponse::FormatHttpDate(lastModifiedTime);
+    respHeaders.SetHeader(HDR_ETAG, etag);
+    respHeaders.SetHeader(HDR_LAST_MODIFIED, lastModified);
+    respHeaders.SetHeader(HDR_ACCEPT_RANGES, "bytes");
+
+    if (NotModified(pRequest, etag, lastModifiedTime))
+    {
+        // the client's copy is current - only the headers go back and the
+        // file is not touched
+        pResponse->SetStatus(304, "Not Modified");
+        respHeaders.RemoveHeader(HDR_CONTENT_TYPE);
+        respHeaders.RemoveHeader(HDR_CONTENT_ENCODING);
+        pStage->SendEvent_OutputToModule(pConnection, pNextModule,
+                               pResponse->NewContFinishedPart(pNextModule));
+        return ;
+    }
+
+    SByteRangeList  ranges;
+    int             rangeResult = RequestedRanges(pRequest, sendSize, lastModified, etag, ranges);
+    if (rangeResult < 0)
+    {
+        char contentRange[64];
+        snprintf(contentRange, sizeof(contentRange), "bytes */%lld", (long long)sendSize);
+        pResponse->SetStatus(416, "Requested Range Not Satisfiable");
+        respHeaders.SetHeader(HDR_CONTENT_RANGE, contentRange);
+        respHeaders.SetHeader(HDR_CONTENT_TYPE, "text/text");
+        respHeaders.RemoveHeader(HDR_CONTENT_ENCODING);
+
+        SRawBodyPart *pRawPart = pResponse->NewRawBodyPart();
+        pRawPart->SetBody("Requested range not satisfiable.");
+        pStage->SendEvent_OutputToModule(pConnection, pNextModule, pRawPart);
+    }
+    else if (rangeResult == 0 || ranges.size() == 1)
+    {
+        SBodyPart *pPart = NULL;
+        if (pContents != NULL)
+        {
+            // small files kept in memory go out with the headers in one write
+            SSegmentedBodyPart *pSegmentedPart = pResponse->NewSegmentedBodyPart();
+            pSegmentedPart->SetFileContents(true);
+            if (rangeResult > 0)
+                pSegmentedPart->Append(pContents, ranges[0].first, ranges[0].second);
+            else
+                pSegmentedPart->Append(pContents);
+            pPart = pSegmentedPart;
+        }
+        else
+        {
+            SFileBodyPart *pFilePart = pSendFile != NULL ?
+                                        pResponse->NewOpenFileBodyPart(sendPath, pSendFile, sendSize, fileOffset) :
+                                        pResponse->NewFileBodyPart(sendPath);
+            if (pFilePart != NULL && rangeResult > 0)
+                pFilePart->SetRange(ranges[0].first, ranges[0].second);
+            pPart = pFilePart;
+        }
+
+        if (pPart != NULL && rangeResult > 0)
+        {
+            char contentRange[96];
+            snprintf(contentRange, sizeof(contentRange), "bytes %lld-%lld/%lld",
+                     (long long)ranges[0].first,
+                     (long long)(ranges[0].first + ranges[0].second - 1),
+                     (long long)sendSize);
+            pResponse->SetStatus(206, "Partial Content");
+            respHeaders.SetHeader(HDR_CONTENT_RANGE, contentRange);
+        }
+        if (pPart != NULL)
+            respHeaders.SetContentLength(rangeResult > 0 ? (off_t)ranges[0].second : sendSize);
+        pStage->SendEvent_OutputToModule(pConnection, pNextModule, pPart);
+    }
+    else
+    {
+        // each range goes in a sub message of its own
+        char boundary[64];
+        snprintf(boundary, sizeof(boundary), "HALLEY_BYTERANGES_%08lx%08lx",
+                 (unsigned long)random(), (unsigned long)lastModifiedTime);
+
+        pResponse->SetStatus(206, "Partial Content");
+        respHeaders.SetHeader(HDR_CONTENT_TYPE, SString("multipart/byteranges; boundary=") + boundary);
+        respHeaders.SetHeader(HDR_TRANSFER_ENCODING, "chunked");
+
+        SRawBodyPart *pOpener = pResponse->NewRawBodyPart();
+        pOpener->bpType = SHttpMessage::HTTP_BP_OPEN_SUB_MESSAGE;
+        pOpener->SetBody(boundary);
+        pStage->SendEvent_OutputToModule(pConnection, pNextModule, pOpener);
+
+        for (SByteRangeList::iterator iter = ranges.begin();iter != ranges.end();++iter)
+        {
+            SFileBodyPart *pFilePart = pSendFile != NULL ?
+                                        pResponse->NewOpenFileBodyPart(sendPath, pSendFile, sendSize, fileOffset) :
+                                        pResponse->NewFileBodyPart(sendPath);
+            if (pFilePart == NULL)
+                break ;
+            pFilePart->SetRange(iter->first, iter->second);
+            pFilePart->contentType = contentType;
+            pStage->SendEvent_OutputToModule(pConnection, pNextModule, pFilePart);
+        }
+    }
+
+    pStage->SendEvent_OutputToModule(pConnection, pNextModule,
+                           pResponse->NewContFinishedPart(pNextModule));
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Checks whether a GET or HEAD request's validators show that
+ *  the client already has the current version of a file.
+ *
+ *  If-None-Match is checked when there is one (with the weak comparison
+ *  so "W/" prefixes are ignored) and If-Modified-Since only otherwise.  A
+ *  date that cannot be parsed is ignored.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+bool SFileModule::NotModified(SHttpRequest *    pRequest,
+                              const SString &   etag,
+                              time_t            lastModified)
+{
+    if (pRequest->Method() != "GET" && pRequest->Method() != "HEAD")
+        return false;
+
+    SHeaderTable &  reqHeaders  = pRequest->Headers();
+    const SString * pIfNoneMatch = reqHeaders.HeaderValue(HDR_IF_NONE_MATCH);
+    if (pIfNoneMatch != NULL)
+    {
+        const char *pCurr   = pIfNoneMatch->c_str();
+        const char *pTag    = etag.c_str();
+        if (strncmp(pTag, "W/", 2) == 0)
+            pTag += 2;
+        size_t      tagLen  = strlen(pTag);
+
+        while (*pCurr)
+        {
+            while (*pCurr == ' ' || *pCurr == '\t' || *pCurr == ',') pCurr++;
+            if (*pCurr == 0)
+                break ;
+            if (*pCurr == '*')
+                return true;
+            if (strncmp(pCurr, "W/", 2) == 0)
+                pCurr += 2;
+
+            // the quoted opaque tag
+            const char *pEnd = *pCurr == '"' ? strchr(pCurr + 1, '"') : NULL;
+            if (pEnd == NULL)
+                return false;
+            pEnd++;
+            if ((size_t)(pEnd - pCurr) == tagLen && strncmp(pCurr, pTag, tagLen) == 0)
+                return true;
+            pCurr = pEnd;
+        }
+        return false;
+    }
+
+    const SString *pIfModifiedSince = reqHeaders.HeaderValue(HDR_IF_MODIFIED_SINCE);
+    if (pIfModifiedSince != NULL)
+    {
+        time_t since = SHttpResponse::ParseHttpDate(*pIfModifiedSince);
+        return since >= 0 && lastModified <= since;
+    }
+    return false;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Gets the byte ranges a request asks for from its Range header.
+ *
+ *  Ranges are only honoured for GET and HEAD requests, and when there is
+ *  an If-Range header only if it matches the file's Last-Modified date or
+ *  is exactly its (strong) ETag.
+ *  A header that cannot be parsed or has too many ranges is ignored (so
+ *  the whole file is sent).  Ranges beyond the end of the file are
+ *  dropped and if none are left -1 is returned.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+int SFileModule::RequestedRanges(SHttpRequest *     pRequest,
+                                 off_t              fileSize,
+                                 const SString &    lastModified,
+                                 const SString &    etag,
+                                 SByteRangeList &   ranges)
+{
+    SHeaderTable &  reqHeaders  = pRequest->Headers();
+    const SString * pRange      = reqHeaders.HeaderValue(HDR_RANGE);
+    ranges.clear();
+
+    if (pRange == NULL || (pRequest->Method() != "GET" && pRequest->Method() != "HEAD"))
+        return 0;
+
+    // a stale If-Range gets the whole file
+    const SString *pIfRange = reqHeaders.HeaderValue(HDR_IF_RANGE);
+    if (pIfRange != NULL && *pIfRange != lastModified && *pIfRange != etag)
+        return 0;
+
+    const char *pCurr = pRange->c_str();
+    if (strncasecmp(pCurr, "bytes=", 6) != 0)
+        return 0;
+    pCurr += 6;
+
+    size_t numSpecs = 0;
+    while (*pCurr)
+    {
+        while (*pCurr == ' ' || *pCurr == '\t' || *pCurr == ',') pCurr++;
+        if (*pCurr == 0)
+            break ;
+
+        // first-last, first- or -suffixLength
+        char *      pEnd    = NULL;
+        long long   first   = -1;
+        long long   last    = -1;
+        if (isdigit(*pCurr))
+        {
+            first = strtoll(pCurr, &pEnd, 10);
+            pCurr = pEnd;
+        }
+        if (*pCurr != '-')
+            return 0;
+        pCurr++;
+        if (isdigit(*pCurr))
+        {
+            last  = strtoll(pCurr, &pEnd, 10);
+            pCurr = pEnd;
+        }
+        while (*pCurr == ' ' || *pCurr == '\t') pCurr++;
+        if ((*pCurr != ',' && *pCurr != 0) || (first < 0 && last < 0) ||
+            (first >= 0 && last >= 0 && last < first) ||
+            ++numSpecs > MAX_RANGES)
+        {
+            return 0;
+        }
+
+        if (first < 0)
+        {
+            // the last "last" bytes
+            if (last == 0)
+                continue ;
+            first = last >= fileSize ? 0 : fileSize - last;
+            last  = fileSize - 1;
+        }
+        else if (first >= fileSize)
+        {
+            continue ;
+        }
+        else if (last < 0 || last >= fileSize)
+        {
+            last = fileSize - 1;
+        }
+        ranges.push_back(SByteRange(first, last - first + 1));
+    }
+
+    return ranges.empty() ? -1 : 1;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Looks for a brotli (file.br) or gzip (file.gz) copy of a file
+ *  that the client accepts, preferring whichever it rates higher (brotli
+ *  on a tie).
+ *
+ *  Copies older than the file are ignored as stale.  hasVariants is set
+ *  if any usable copy exists, as the response then depends on
+ *  Accept-Encoding even when the plain file is sent.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+bool SFileModule::FindPrecompressed(const SString &     fullpath,
+                                    const struct stat & fileStat,
+                                    SHttpRequest *      pRequest,
+                                    SString &           variantPath,
+                                    const char *&       encoding,
+                                    bool &              hasVariants)
+{
+    bool available[SFileCacheEntry::NUM_VARIANTS];
+
+    hasVariants = false;
+    for (int i = 0;i < SFileCacheEntry::NUM_VARIANTS;i++)
+    {
+        struct stat variantStat;
+        available[i] = stat((fullpath + SFileCacheEntry::VARIANT_EXTENSIONS[i]).c_str(), &variantStat) == 0 &&
+                       S_ISREG(variantStat.st_mode) &&
+                       variantStat.st_mtime >= fileStat.st_mtime;
+        hasVariants  = hasVariants || available[i];
+    }
+
+    int variant = ChoosePrecompressed(pRequest, available);
+    if (variant < 0)
+        return false;
+
+    variantPath = fullpath + SFileCacheEntry::VARIANT_EXTENSIONS[variant];
+    encoding    = SFileCacheEntry::VARIANT_ENCODINGS[variant];
+    return true;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Picks the precompressed variant the client rates highest out
+ *  of those available (brotli on a tie).  Returns -1 if it accepts none
+ *  of them.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+int SFileModule::ChoosePrecompressed(SHttpRequest *pRequest,
+                                     const bool available[SFileCacheEntry::NUM_VARIANTS])
+{
+    const SString * pAccept     = pRequest->Headers().HeaderValue(HDR_ACCEPT_ENCODING);
+    int             bestQuality = 0;
+    int             bestVariant = -1;
+    if (pAccept == NULL)
+        return -1;
+
+    for (int i = 0;i < SFileCacheEntry::NUM_VARIANTS;i++)
+    {
+        int quality = available[i] ? SCompressionModule::EncodingQuality(*pAccept, SFileCacheEntry::VARIANT_ENCODINGS[i]) : -1;
+        if (quality > bestQuality)
+        {
+            bestQuality = quality;
+            bestVariant = i;
+        }
+    }
+    return bestVariant;
+}
+
 //*****************************************************************************
 /*!
  *  \brief  Helper to send down a file.
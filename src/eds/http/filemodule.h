@@ -28,14 +28,33 @@
 #define _SFILE_MODULE_H_
 
 #include "httpmodule.h"
+#include "filecache.h"
+
+//! A byte range of a file - [first, first + second)
+typedef std::pair<off_t, size_t>    SByteRange;
+typedef std::vector<SByteRange>     SByteRangeList;
 
 //! A module for serving static files relative to a doc root folder.
+//
+// Range requests are served with 206 responses - a single range as a
+// ranged file part and multiple ranges as a multipart/byteranges message
+// of ranged file parts (sent chunked).
+//
+// Files carry an ETag and Last-Modified date and conditional GETs that
+// show the client's copy is current are answered with a 304.
+//
+// With a file cache set, files are looked up in the cache instead of
+// being stat'ed and opened for each request.
 class SFileModule : public SHttpModule
 {
+public:
+    //! Most ranges served in one response
+    const static size_t MAX_RANGES;
+
 public:
     //! Creates the file module
     SFileModule(SHttpModule *pNext, bool indexes = false) :
-        SHttpModule(pNext), showIndexes(indexes) { }
+        SHttpModule(pNext), showIndexes(indexes), servePrecompressed(true), pFileCache(NULL) { }
 
     //! Destructor 
     virtual ~SFileModule() { }
@@ -53,6 +72,28 @@ public:
                          SHttpResponse *    pResponse,
                          SHeaderTable &     respHeaders);
 
+    //! Sends a file (or the requested ranges of it) to the next module
+    void SendFileParts(SConnection *        pConnection,
+                       SHttpHandlerStage *  pStage,
+                       SHttpRequest *       pRequest,
+                       const SString &      fullpath,
+                       const struct stat &  fileStat,
+                       SFileCacheEntry *    pEntry = NULL);
+
+    //! Sends the chosen copy of a file (or the requested ranges of it or a
+    // 304) to the next module
+    void SendRepresentation(SConnection *       pConnection,
+                            SHttpHandlerStage * pStage,
+                            SHttpRequest *      pRequest,
+                            const SString &     sendPath,
+                            SSharedFile *       pSendFile,
+                            off_t               fileOffset,
+                            off_t               sendSize,
+                            SSharedBuffer *     pContents,
+                            const SString &     contentType,
+                            const SString &     etag,
+                            time_t              lastModifiedTime);
+
     //! Print contents of directory
     static SString PrintDirContents(const SString &docroot, const SString &filename, const SString &prefix, bool raw = false);
 
@@ -68,12 +109,58 @@ public:
     //! Parses a resource path to its docroot and child path components
     virtual bool ParsePath(const SString &path, SString &docroot, SString &child, SString &prefix);
 
+    //! Sets whether .br/.gz files next to a file are sent in its place to
+    // clients that accept them
+    void SetServePrecompressed(bool yes) { servePrecompressed = yes; }
+
+    //! Sets the cache files are looked up in (NULL to stat and open files
+    // for each request).  The cache can be shared by modules.
+    void SetFileCache(SFileCache *pCache) { pFileCache = pCache; }
+
+    //! Tells if a request's If-None-Match or If-Modified-Since shows the
+    // client's copy of a file is current (so a 304 can be sent)
+    static bool NotModified(SHttpRequest *  pRequest,
+                            const SString & etag,
+                            time_t          lastModified);
+
+    //! Gets the ETag of a file's copy with the given content encoding (or
+    // of the file itself if encoding is NULL)
+    static SString EncodedETag(const SString &etag, const char *encoding);
+
+    //! Gets the ranges of a file a request asks for.  Returns 1 if there
+    // are ranges to send, 0 if the whole file is to be sent and -1 if none
+    // of the ranges could be satisfied.
+    static int RequestedRanges(SHttpRequest *       pRequest,
+                               off_t                fileSize,
+                               const SString &      lastModified,
+                               const SString &      etag,
+                               SByteRangeList &     ranges);
+
+    //! Finds a precompressed variant of a file the client accepts
+    static bool FindPrecompressed(const SString &       fullpath,
+                                  const struct stat &   fileStat,
+                                  SHttpRequest *        pRequest,
+                                  SString &             variantPath,
+                                  const char *&         encoding,
+                                  bool &                hasVariants);
+
+    //! Picks the precompressed variant the client rates highest out of
+    // those available.  Returns -1 if it accepts none of them.
+    static int ChoosePrecompressed(SHttpRequest *pRequest,
+                                   const bool available[SFileCacheEntry::NUM_VARIANTS]);
+
 protected:
     //! The document roots for each prefix
     std::list<SStringPair> docRoots;
 
     //! Whether (sub) directory's can be listed
     bool            showIndexes;
+
+    //! Whether precompressed variants of files are served
+    bool            servePrecompressed;
+
+    //! Cache files are looked up in (not owned)
+    SFileCache *    pFileCache;
 };
 
 #endif
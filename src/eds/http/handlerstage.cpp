@@ -85,6 +85,34 @@ bool SHttpHandlerStage::SendEvent_InputToModule(SConnection *pConnection, SHttpM
     }
 }
 
+//! Called by a module when it is done with a streamed input body part.
+// The part is destroyed and the reader is told so it can read more.
+bool SHttpHandlerStage::SendEvent_InputConsumed(SConnection *pConnection, SBodyPart *pBodyPart)
+{
+    assert("BodyPart CANNOT be NULL" && pBodyPart != NULL);
+    size_t numBytes = 0;
+    if (pBodyPart->Type() == SBodyPart::BP_RAW)
+        numBytes = ((SRawBodyPart *)pBodyPart)->Size();
+    delete pBodyPart;
+
+    if (numBytes == 0)
+        return true;
+    return pReaderStage->SendEvent_BodyConsumed(pConnection, numBytes);
+}
+
+//! Gets the module a request's body is to be streamed to (if any)
+SHttpModule *SHttpHandlerStage::RequestBodyModule(SHttpRequest *pRequest)
+{
+    return pRootModule == NULL ? NULL : pRootModule->RequestBodyModule(pRequest);
+}
+
+//! Asks the modules if a request's body is wanted before the client
+// sends it (for "Expect: 100-continue")
+bool SHttpHandlerStage::AcceptRequestBody(SHttpRequest *pRequest)
+{
+    return pRootModule == NULL || pRootModule->AcceptRequestBody(pRequest);
+}
+
 //! Sends output to be processed by a module
 bool SHttpHandlerStage::SendEvent_OutputToModule(SConnection *  pConnection,
                                                  SHttpModule *  pNextModule,
@@ -117,6 +145,17 @@ bool SHttpHandlerStage::SendEvent_WriteBodyPart(SConnection *   pConnection,
     // otherwise get the writer stage to send it out
     assert("Request AND BodyPart must be NON-NULL" && pRequest != NULL && pBodyPart != NULL);
     pBodyPart->extra_data = pRequest;
+
+    // the response is complete as far as the modules are concerned so the
+    // next pipelined request (if any) can be handled while this is written.
+    // This is sent before the part is queued so it cannot arrive after the
+    // writer has finished the batch and the connection has been reused.
+    if (pBodyPart->Type() == SHttpMessage::HTTP_BP_CONTENT_FINISHED &&
+        !pRequest->Headers().CloseConnection())
+    {
+        pReaderStage->SendEvent_RequestHandled(pConnection, pRequest);
+    }
+
     return pWriterStage->SendEvent_WriteBodyPart(pConnection, pBodyPart);
 }
 
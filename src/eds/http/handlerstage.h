@@ -84,6 +84,15 @@ public:
     //! Sends input to be processed by a module
     virtual bool SendEvent_InputToModule(SConnection *pConnection, SHttpModule *pModule, SBodyPart *pBodyPart = NULL);
     
+    //! Called by a module when it is done with a streamed input body part
+    virtual bool SendEvent_InputConsumed(SConnection *pConnection, SBodyPart *pBodyPart);
+
+    //! Gets the module a request's body is to be streamed to (if any)
+    virtual SHttpModule *RequestBodyModule(SHttpRequest *pRequest);
+
+    //! Asks the modules if a request's body is wanted (for "Expect: 100-continue")
+    virtual bool AcceptRequestBody(SHttpRequest *pRequest);
+
     //! Sends output to be processed by a module
     virtual bool SendEvent_OutputToModule(SConnection *pConnection, SHttpModule *pModule, SBodyPart *pBodyPart = NULL);
 
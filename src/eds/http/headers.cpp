@@ -31,19 +31,174 @@
 const SString TRUE_STRING = "true";
 const SString FALSE_STRING = "false";
 
+//! Canonical names of the well known headers (in SHttpHeaderId order)
+static const SString KNOWN_HEADER_NAMES[HDR_NUM_KNOWN] =
+{
+    "Accept",
+    "Accept-Encoding",
+    "Accept-Ranges",
+    "Authorization",
+    "Cache-Control",
+    "Connection",
+    "Content-Encoding",
+    "Content-Length",
+    "Content-Range",
+    "Content-Type",
+    "Cookie",
+    "Date",
+    "ETag",
+    "Expect",
+    "Host",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "Keep-Alive",
+    "Last-Modified",
+    "Location",
+    "Range",
+    "Server",
+    "Set-Cookie",
+    "Transfer-Encoding",
+    "User-Agent",
+    "Vary",
+};
+
+//! Size of the well known header hash table - must be a power of 2
+static const unsigned KNOWN_HEADER_HASH_SIZE = 128;
+
+//! Hashes a header name on its length and (case folded) ends
+static inline unsigned KnownHeaderHash(const char *name, size_t length)
+{
+    return (length * 7 + (tolower(name[0]) << 1) + tolower(name[length - 1])) & (KNOWN_HEADER_HASH_SIZE - 1);
+}
+
+//! Open addressed hash table of the well known header ids
+class SKnownHeaderIndex
+{
+public:
+    SKnownHeaderIndex()
+    {
+        for (unsigned i = 0;i < KNOWN_HEADER_HASH_SIZE;i++)
+            slots[i] = HDR_UNKNOWN;
+        for (int id = 0;id < HDR_NUM_KNOWN;id++)
+        {
+            const SString &name = KNOWN_HEADER_NAMES[id];
+            unsigned hash = KnownHeaderHash(name.c_str(), name.size());
+            while (slots[hash] != HDR_UNKNOWN)
+                hash = (hash + 1) & (KNOWN_HEADER_HASH_SIZE - 1);
+            slots[hash] = id;
+        }
+    }
+
+    SHttpHeaderId Find(const char *name, size_t length) const
+    {
+        if (length == 0)
+            return HDR_UNKNOWN;
+
+        unsigned hash = KnownHeaderHash(name, length);
+        while (slots[hash] != HDR_UNKNOWN)
+        {
+            const SString &known = KNOWN_HEADER_NAMES[slots[hash]];
+            if (known.size() == length && strncasecmp(known.c_str(), name, length) == 0)
+                return (SHttpHeaderId)slots[hash];
+            hash = (hash + 1) & (KNOWN_HEADER_HASH_SIZE - 1);
+        }
+        return HDR_UNKNOWN;
+    }
+
+private:
+    int slots[KNOWN_HEADER_HASH_SIZE];
+};
+
+//! "Name: " prefixes of the well known headers
+class SKnownHeaderPrefixes
+{
+public:
+    SKnownHeaderPrefixes()
+    {
+        for (int id = 0;id < HDR_NUM_KNOWN;id++)
+            prefixes[id] = KNOWN_HEADER_NAMES[id] + ": ";
+    }
+
+    const SString &operator[](int id) const { return prefixes[id]; }
+
+private:
+    SString prefixes[HDR_NUM_KNOWN];
+};
+
+//! Gets the id of a well known header
+SHttpHeaderId SHeaderTable::HeaderId(const char *name, size_t length)
+{
+    static SKnownHeaderIndex knownHeaders;
+    return knownHeaders.Find(name, length);
+}
+
+//! Gets the canonical name of a well known header
+const SString &SHeaderTable::HeaderName(SHttpHeaderId id)
+{
+    assert("Invalid header id" && id >= 0 && id < HDR_NUM_KNOWN);
+    return KNOWN_HEADER_NAMES[id];
+}
+
+//! Creates a header table
+SHeaderTable::SHeaderTable()
+{
+    Reset();
+    locked = false;
+}
+
 //! CLears the header table so we can start over again
 void SHeaderTable::Reset()
 {
     closeConnection = false;
+    contentLength   = 0;
     locked          = false;
     headers.clear();
+    for (int i = 0;i < HDR_NUM_KNOWN;i++)
+        knownSlots[i] = -1;
+}
+
+//! Appends the headers (and the blank line after them) to a buffer
+void SHeaderTable::AppendTo(SString &output) const
+{
+    // built in a single (thread safe) static initialisation as writer
+    // threads serialise heads at the same time
+    static const SKnownHeaderPrefixes knownPrefixes;
+
+    // map slots back to ids so known names are not formatted again
+    int knownIds[64];
+    int numHeaders = headers.size();
+    for (int i = 0;i < numHeaders && i < 64;i++)
+        knownIds[i] = HDR_UNKNOWN;
+    for (int id = 0;id < HDR_NUM_KNOWN;id++)
+    {
+        if (knownSlots[id] >= 0 && knownSlots[id] < 64)
+            knownIds[knownSlots[id]] = id;
+    }
+
+    for (int i = 0;i < numHeaders;i++)
+    {
+        const HeaderPair &header = headers[i];
+        if (i < 64 && knownIds[i] != HDR_UNKNOWN)
+        {
+            output += knownPrefixes[knownIds[i]];
+        }
+        else
+        {
+            output += header.first;
+            output += ": ";
+        }
+        output += header.second;
+        output += URLUtils::CRLF;
+    }
+    output += URLUtils::CRLF;
 }
 
 //! Write the headers to the stream
 int SHeaderTable::WriteToStream(std::ostream &output)
 {
     // write all headers!
-    HeaderMap::const_iterator iter = headers.begin();
+    HeaderList::const_iterator iter = headers.begin();
     for (;iter != headers.end();++iter)
     {
         output << iter->first << ": " << iter->second << URLUtils::CRLF;
@@ -116,70 +271,131 @@ bool SHeaderTable::ParseHeaderLine(const SString &line, SString &name, SString &
     return true;
 }
 
+//! Index of a header in the list or -1 if not found
+int SHeaderTable::FindHeader(const SString &name, SHttpHeaderId id) const
+{
+    if (id != HDR_UNKNOWN)
+        return knownSlots[id];
+
+    for (size_t i = 0;i < headers.size();i++)
+    {
+        const SString &hdrName = headers[i].first;
+        if (hdrName.size() == name.size() && strcasecmp(hdrName.c_str(), name.c_str()) == 0)
+            return i;
+    }
+    return -1;
+}
+
 // Tells if a header exists
 bool SHeaderTable::HasHeader(const SString &name) const
 {
-    HeaderMap::const_iterator iter = headers.find(name);
-    return iter != headers.end();
+    return FindHeader(name, HeaderId(name)) >= 0;
 }
 
 // Gets a header
 SString SHeaderTable::Header(const SString &name) const
 {
-    HeaderMap::const_iterator iter = headers.find(name);
-    if (iter == headers.end())
-        return "";
-    else
-        return iter->second;
+    const SString *pValue = HeaderValue(name);
+    return pValue == NULL ? "" : *pValue;
+}
+
+//! Gets a well known header
+const SString &SHeaderTable::Header(SHttpHeaderId id) const
+{
+    static const SString EMPTY_STRING;
+    const SString *pValue = HeaderValue(id);
+    return pValue == NULL ? EMPTY_STRING : *pValue;
+}
+
+//! Gets a pointer to a header's value
+const SString *SHeaderTable::HeaderValue(const SString &name) const
+{
+    int index = FindHeader(name, HeaderId(name));
+    return index < 0 ? NULL : &(headers[index].second);
+}
+
+//! Gets a pointer to a well known header's value
+const SString *SHeaderTable::HeaderValue(SHttpHeaderId id) const
+{
+    int index = knownSlots[id];
+    return index < 0 ? NULL : &(headers[index].second);
 }
 
 //! Returns a header if it exists
-bool SHeaderTable::HeaderIfExists(const SString &name, SString &value)
+bool SHeaderTable::HeaderIfExists(const SString &name, SString &value) const
 {
-    HeaderMap::const_iterator iter = headers.find(name);
-    if (iter == headers.end())
+    const SString *pValue = HeaderValue(name);
+    if (pValue == NULL)
         return false;
 
-    value = iter->second;
+    value = *pValue;
     return true;
 }
 
-// Sets a header value - if it already exists, this value is appended to it.
+// Sets a header value - if it already exists, the value is replaced
+// unless append is set in which case it is added to the list of values.
 void SHeaderTable::SetHeader(const SString &name, const SString &value, bool append)
 {
     if (locked) return ;
 
-    HeaderMap::iterator iter = headers.find(name);
-    if (iter != headers.end())
+    SHttpHeaderId id = HeaderId(name);
+    SetHeaderAt(FindHeader(name, id), id, name, value, append);
+}
+
+//! Sets the value of a well known header
+void SHeaderTable::SetHeader(SHttpHeaderId id, const SString &value, bool append)
+{
+    if (locked) return ;
+
+    SetHeaderAt(knownSlots[id], id, KNOWN_HEADER_NAMES[id], value, append);
+}
+
+//! Sets the value of the header at an index or adds a new one
+void SHeaderTable::SetHeaderAt(int index, SHttpHeaderId id, const SString &name, const SString &value, bool append)
+{
+    if (index < 0)
     {
-        if (append)
-        {
-            SStringStream newvalue;
-            newvalue << iter->second << "," << value;
-            headers.insert(HeaderPair(name, newvalue.str()));
-        }
-        else
-        {
-            headers[name] = value;
-        }
+        index = headers.size();
+        headers.push_back(HeaderPair(id == HDR_UNKNOWN ? name : KNOWN_HEADER_NAMES[id], value));
+        if (id != HDR_UNKNOWN)
+            knownSlots[id] = index;
+    }
+    else if (append)
+    {
+        headers[index].second += ",";
+        headers[index].second += value;
     }
     else
     {
-        headers.insert(HeaderPair(name, value));
+        headers[index].second = value;
     }
 
-    if ((strcasecmp(name.c_str(), "Connection") == 0) &&
-        (strcasecmp(value.c_str(), "close") == 0))
+    if (id != HDR_UNKNOWN)
+        HeaderChanged(id, &(headers[index].second));
+}
+
+//! Updates values parsed from well known headers
+void SHeaderTable::HeaderChanged(SHttpHeaderId id, const SString *pValue)
+{
+    if (id == HDR_CONNECTION)
     {
-        closeConnection = true;
+        closeConnection = pValue != NULL && strcasecmp(pValue->c_str(), "close") == 0;
     }
-
-    if (strcasecmp(name.c_str(), "content-length") == 0)
+    else if (id == HDR_CONTENT_LENGTH)
     {
-        // contentLength = atoi(value.c_str());
+        contentLength = 0;
+        if (pValue != NULL)
+        {
+            char *pEnd = NULL;
+            errno = 0;
+            long long length = strtoll(pValue->c_str(), &pEnd, 10);
+            if (pValue->empty() || *pEnd != 0 || length < 0 || errno == ERANGE)
+                contentLength = -1;
+            else
+                contentLength = length;
+        }
     }
 }
-
 //! Sets the value of an bool typed header
 void SHeaderTable::SetBoolHeader(const SString &name, bool value)
 {
@@ -210,18 +426,54 @@ void SHeaderTable::SetDoubleHeader(const SString &name, double value)
     SetHeader(name, &valueStr[0]);
 }
 
+//! Sets the Content-Length (which can be past 2GB)
+void SHeaderTable::SetContentLength(off_t length)
+{
+    char valueStr[32];
+    snprintf(valueStr, sizeof(valueStr), "%lld", (long long)length);
+    SetHeader(HDR_CONTENT_LENGTH, valueStr);
+}
+
 // Removes a header
 SString SHeaderTable::RemoveHeader(const SString &name)
 {
-    if ( ! locked)
+    if (locked)
+        return "";
+
+    SHttpHeaderId id = HeaderId(name);
+    return RemoveHeaderAt(FindHeader(name, id), id);
+}
+
+//! Removes a well known header
+SString SHeaderTable::RemoveHeader(SHttpHeaderId id)
+{
+    if (locked)
+        return "";
+
+    return RemoveHeaderAt(knownSlots[id], id);
+}
+
+//! Removes the header at the given index
+SString SHeaderTable::RemoveHeaderAt(int index, SHttpHeaderId id)
+{
+    if (index < 0)
+        return "";
+
+    SString value = headers[index].second;
+    headers.erase(headers.begin() + index);
+
+    // headers after the removed one have moved up
+    for (int i = 0;i < HDR_NUM_KNOWN;i++)
     {
-        HeaderMap::iterator iter = headers.find(name);
-        if (iter != headers.end())
-        {
-            headers.erase(iter);
-            return iter->second;
-        }
+        if (knownSlots[i] > index)
+            knownSlots[i]--;
+    }
+
+    if (id != HDR_UNKNOWN)
+    {
+        knownSlots[id] = -1;
+        HeaderChanged(id, NULL);
     }
-    return "";
+    return value;
 }
 
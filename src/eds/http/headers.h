@@ -31,11 +31,48 @@
 #include "utils/urlutils.h"
 #include "httpfwd.h"
 
-typedef std::map<SString, SString>   HeaderMap;
+#include <vector>
+
 typedef std::pair<SString, SString>  HeaderPair;
+typedef std::vector<HeaderPair>      HeaderList;
 typedef std::map<SString, SString>   CookieMap;
 typedef std::pair<SString, SString>  CookiePair;
 
+//! Well known headers - these get their own slots in a header table so
+// they can be found without comparing names.
+typedef enum
+{
+    HDR_UNKNOWN = -1,
+    HDR_ACCEPT,
+    HDR_ACCEPT_ENCODING,
+    HDR_ACCEPT_RANGES,
+    HDR_AUTHORIZATION,
+    HDR_CACHE_CONTROL,
+    HDR_CONNECTION,
+    HDR_CONTENT_ENCODING,
+    HDR_CONTENT_LENGTH,
+    HDR_CONTENT_RANGE,
+    HDR_CONTENT_TYPE,
+    HDR_COOKIE,
+    HDR_DATE,
+    HDR_ETAG,
+    HDR_EXPECT,
+    HDR_HOST,
+    HDR_IF_MODIFIED_SINCE,
+    HDR_IF_NONE_MATCH,
+    HDR_IF_RANGE,
+    HDR_KEEP_ALIVE,
+    HDR_LAST_MODIFIED,
+    HDR_LOCATION,
+    HDR_RANGE,
+    HDR_SERVER,
+    HDR_SET_COOKIE,
+    HDR_TRANSFER_ENCODING,
+    HDR_USER_AGENT,
+    HDR_VARY,
+    HDR_NUM_KNOWN
+} SHttpHeaderId;
+
 //! A header in the message
 class SHeader
 {
@@ -65,12 +102,24 @@ protected:
     SString value;
 };
 
-//! Table of headers
+//*****************************************************************************
+/*!
+ *  \class  SHeaderTable
+ *
+ *  \brief  Table of headers.
+ *
+ *  Header names are case insensitive.  Headers are kept in the order they
+ *  were added in a flat list.  Well known headers are also indexed by
+ *  their SHttpHeaderId so looking them up does not involve any string
+ *  compares or allocations, the rest are found by a scan of the list.
+ *  The connection and content length values are parsed once when set.
+ *
+ *****************************************************************************/
 class SHeaderTable
 {
 public:
     //! Creates a header table
-    SHeaderTable() : locked(false) { }
+    SHeaderTable();
 
     //! Destructor
     virtual ~SHeaderTable() { }
@@ -78,18 +127,42 @@ public:
     //! Resets to start all over again
     virtual void Reset();
 
+    //! Gets the id of a well known header (HDR_UNKNOWN for the rest)
+    static SHttpHeaderId HeaderId(const char *name, size_t length);
+
+    //! Gets the id of a well known header (HDR_UNKNOWN for the rest)
+    static SHttpHeaderId HeaderId(const SString &name) { return HeaderId(name.c_str(), name.size()); }
+
+    //! Gets the canonical name of a well known header
+    static const SString &HeaderName(SHttpHeaderId id);
+
     //! Gets a header
     SString Header(const SString &name) const;
 
+    //! Gets a well known header (an empty string if it is not set)
+    const SString &Header(SHttpHeaderId id) const;
+
+    //! Gets a pointer to a header's value or NULL if it is not set
+    const SString *HeaderValue(const SString &name) const;
+
+    //! Gets a pointer to a well known header's value or NULL if it is not set
+    const SString *HeaderValue(SHttpHeaderId id) const;
+
     //! Returns a header if it exists
-    bool HeaderIfExists(const SString &name, SString &value);
+    bool HeaderIfExists(const SString &name, SString &value) const;
 
     //! Tells if a header is available
     bool HasHeader(const SString &name) const;
 
+    //! Tells if a well known header is available
+    bool HasHeader(SHttpHeaderId id) const { return knownSlots[id] >= 0; }
+
     //! Sets the value of an string typed header
     void SetHeader(const SString &name, const SString &value, bool append = false);
 
+    //! Sets the value of a well known header
+    void SetHeader(SHttpHeaderId id, const SString &value, bool append = false);
+
     //! Sets the value of an bool typed header
     void SetBoolHeader(const SString &name, bool value);
 
@@ -102,14 +175,20 @@ public:
     //! Sets the value of an double typed header
     void SetDoubleHeader(const SString &name, double value);
 
+    //! Sets the Content-Length (which can be past 2GB)
+    void SetContentLength(off_t length);
+
     //! Removes a particular header
     SString RemoveHeader(const SString &name);
 
+    //! Removes a well known header
+    SString RemoveHeader(SHttpHeaderId id);
+
     //! Parses a header line.
     virtual bool ParseHeaderLine(const SString &line, SString &name, SString &value);
 
-    HeaderMap::const_iterator FirstHeader() { return headers.begin(); }
-    HeaderMap::const_iterator LastHeader() { return headers.end(); }
+    HeaderList::const_iterator FirstHeader() { return headers.begin(); }
+    HeaderList::const_iterator LastHeader() { return headers.end(); }
 
     //! Reads the next header
     virtual bool ReadHeaders(std::istream &input);
@@ -120,6 +199,9 @@ public:
     //! Writes the headers to the stream
     virtual int WriteToStream(std::ostream &output);
 
+    //! Appends the headers (and the blank line after them) to a buffer
+    void AppendTo(SString &output) const;
+
     //! Write the headers to a file descriptor
     virtual int WriteToFD(int fd);
 
@@ -132,13 +214,35 @@ public:
     //! Tells if the connection is to be closed or not
     inline bool CloseConnection() const { return closeConnection; }
 
+    //! Gets the parsed Content-Length (0 if not set, -1 if invalid)
+    inline off_t ContentLength() const { return contentLength; }
+
 protected:
-    //! headers
-    HeaderMap   headers;
+    //! Index of a header in the list or -1 if not found
+    int FindHeader(const SString &name, SHttpHeaderId id) const;
+
+    //! Sets the value of the header at an index or adds a new one
+    void SetHeaderAt(int index, SHttpHeaderId id, const SString &name, const SString &value, bool append);
+
+    //! Removes the header at the given index
+    SString RemoveHeaderAt(int index, SHttpHeaderId id);
+
+    //! Updates values parsed from well known headers
+    void HeaderChanged(SHttpHeaderId id, const SString *pValue);
+
+protected:
+    //! headers in the order they were added
+    HeaderList  headers;
+
+    //! Index into headers for each of the well known headers (-1 if not set)
+    int         knownSlots[HDR_NUM_KNOWN];
 
     //! Quick access to whether Connection is to be closed or not
     bool        closeConnection;
 
+    //! The parsed content length
+    off_t       contentLength;
+
     //! Tells if the headers are locked - once locked they cant be changed
     bool        locked;
 };
@@ -38,6 +38,7 @@ class SHttpResponse;
 class SHttpModule;
 class SHttpHandlerData;
 class SHttpReaderStage;
+class SHttpReaderState;
 class SHttpWriterStage;
 class SHttpHandlerStage;
 class SBayeuxModule;
@@ -129,7 +129,7 @@ protected:
     //! true if this module is currently processing this body part.
     bool        processing;
 
-private:
+protected:
     //! A priority of BPs that havent yet been processed.
     SBodyPartQueue      bodyParts;
 };
@@ -220,6 +220,23 @@ public:
     //! Creates new module data if necessary
     virtual SHttpModuleData *CreateModuleData(SHttpHandlerData *pHandlerData);
 
+    //! Called once a request's headers have been read to find the module
+    // (if any) that wants the body streamed to it.  Such a module gets the
+    // request as soon as the headers are in, followed by the body as input
+    // body parts ending with a HTTP_BP_CONTENT_FINISHED part, and must
+    // hand each part to SHttpHandlerStage::SendEvent_InputConsumed when
+    // done with it.  Returning NULL (the default) has the whole body read
+    // before the request is handled.
+    virtual SHttpModule *RequestBodyModule(SHttpRequest *pRequest) { return NULL; }
+
+    //! Called once the headers of a request with "Expect: 100-continue"
+    // have been read, before the client has sent the body.  Returning
+    // true (the default) has the client told to go ahead.  Otherwise the
+    // request is handled without its body (SHttpRequest::BodyDeclined is
+    // set) so a final response such as 401 or 413 can be sent, and the
+    // connection is closed after it.
+    virtual bool AcceptRequestBody(SHttpRequest *pRequest) { return true; }
+
 protected:
     //! Send a body part to another module
     void SendBodyPartToModule(SConnection *         pConnection,
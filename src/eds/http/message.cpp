@@ -32,6 +32,7 @@ SHttpMessage::SHttpMessage()
 {
     version         = "HTTP/1.1";
     bpCount         = 0;
+    numInsertedParts = 0;
     headers.SetHeader("Content-Type", "text/html");
 }
 
@@ -46,6 +47,7 @@ void SHttpMessage::Reset()
     headers.Reset();
     version         = "HTTP/1.1";
     bpCount         = 0;
+    numInsertedParts = 0;
     headers.SetHeader("Content-Type", "text/html");
 }
 
@@ -55,6 +57,25 @@ SRawBodyPart *SHttpMessage::NewRawBodyPart(void *extra_data)
     return new SRawBodyPart(bpCount++, extra_data);
 }
 
+// Creates a part for a module to insert between the parts of the message
+SRawBodyPart *SHttpMessage::NewInsertedBodyPart(void *extra_data)
+{
+    numInsertedParts++;
+    return new SRawBodyPart(0, extra_data);
+}
+
+// Creates a new segmented body part for this message
+SSegmentedBodyPart *SHttpMessage::NewSegmentedBodyPart(void *extra_data)
+{
+    return new SSegmentedBodyPart(bpCount++, extra_data);
+}
+
+// Creates a new lazy body part for this message
+SLazyBodyPart *SHttpMessage::NewLazyBodyPart(SBodyProducer *pProducer, void *extra_data)
+{
+    return new SLazyBodyPart(pProducer, bpCount++, extra_data);
+}
+
 // Creates a new body part for this message
 SFileBodyPart *SHttpMessage::NewFileBodyPart(const SString &filename, void *extra_data)
 {
@@ -69,6 +90,22 @@ SFileBodyPart *SHttpMessage::NewFileBodyPart(const SString &filename, void *extr
     return new SFileBodyPart(filename, fileStat.st_size, bpCount++, extra_data);
 }
 
+// Creates a new body part for a file that is already open
+SFileBodyPart *SHttpMessage::NewOpenFileBodyPart(const SString &filename, SSharedFile *pFile,
+                                                 size_t fileSize, off_t fileOffset,
+                                                 void *extra_data)
+{
+    SFileBodyPart *pPart = new SFileBodyPart(filename, fileSize, bpCount++, extra_data);
+    pPart->SetSharedFile(pFile, fileOffset);
+    return pPart;
+}
+
+// Creates a new body part that spools to disk when it gets large
+SSpooledBodyPart *SHttpMessage::NewSpooledBodyPart(size_t threshold, void *extra_data)
+{
+    return new SSpooledBodyPart(threshold, bpCount++, extra_data);
+}
+
 //! Returns a part that indicates end of content
 SRawBodyPart *SHttpMessage::NewContFinishedPart(SHttpModule *pNextModule)
 {
@@ -96,20 +133,15 @@ const SString &SHttpMessage::Version() const
 }
 
 //! Gets the content length
-int SHttpMessage::ContentLength()
+off_t SHttpMessage::ContentLength()
 {
-    SString length;
-    if (headers.HeaderIfExists("Content-Length", length))
-        return atoi(length.c_str());
-    return 0;
+    return headers.ContentLength();
 }
 
 //! Tells if a response is multipart or not
 bool SHttpMessage::IsMultipart()
 {
-    SString hdrContType;
-    headers.HeaderIfExists("Content-Type", hdrContType);
-    return (strncmp("multipart", hdrContType.c_str(), 9) == 0);
+    return (strncmp("multipart", headers.Header(HDR_CONTENT_TYPE).c_str(), 9) == 0);
 }
 
 // Sets the version
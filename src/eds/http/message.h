@@ -76,7 +76,7 @@ public:
     const SString &Version() const;
 
     //! Gets the content length
-    virtual int ContentLength();
+    virtual off_t ContentLength();
 
     //! Tells if the message is multipart
     virtual bool IsMultipart();
@@ -90,12 +90,37 @@ public:
     //! Creates a new raw body part
     SRawBodyPart *NewRawBodyPart(void *extra_data = NULL);
 
+    //! Creates a raw part for a module to insert into the output of
+    // another module - it does not take up an index in the message's
+    // sequence (the inserting module numbers what it sends on)
+    SRawBodyPart *NewInsertedBodyPart(void *extra_data = NULL);
+
+    //! Creates a new part made of slices of shared buffers
+    SSegmentedBodyPart *NewSegmentedBodyPart(void *extra_data = NULL);
+
+    //! Creates a new part whose data is pulled from a producer as it is
+    // written out (the part takes over the producer)
+    SLazyBodyPart *NewLazyBodyPart(SBodyProducer *pProducer, void *extra_data = NULL);
+
     //! Creates a new file part
     SFileBodyPart *NewFileBodyPart(const SString &filename, void *extra_data = NULL);
 
+    //! Creates a new part for a file that is already open and whose size
+    // is known (the part takes its own reference to the file).  The file
+    // starts at fileOffset within the open file.
+    SFileBodyPart *NewOpenFileBodyPart(const SString &filename, SSharedFile *pFile,
+                                       size_t fileSize, off_t fileOffset = 0,
+                                       void *extra_data = NULL);
+
+    //! Creates a new part that spools to disk past the given size
+    SSpooledBodyPart *NewSpooledBodyPart(size_t threshold, void *extra_data = NULL);
+
     //! Returns a part that indicates end of content
     SRawBodyPart *NewContFinishedPart(SHttpModule *pNextModule);
 
+    //! Gets the number of body parts created since the last Reset
+    size_t NumPartsCreated() const { return bpCount + numInsertedParts; }
+
 public:
     //! Reads the next header
     virtual bool ReadFirstLine(std::istream &input) { return false; }
@@ -112,6 +137,9 @@ protected:
 
     // Number of body parts in this message so far
     BPIndexType     bpCount;
+
+    //! Number of inserted parts (which take no index) so far
+    size_t          numInsertedParts;
 };
 
 #endif
@@ -0,0 +1,264 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   parser.cpp
+ *
+ *  \brief  An incremental http request head parser that works directly
+ *  off a connection's read buffer.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include "utils/urlutils.h"
+#include "parser.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//! Longest line we are willing to buffer
+const size_t SHttpParser::DEFAULT_MAX_LINE_LENGTH = 8192;
+
+//! Tells if a character is allowed in a header name (RFC 2616 token)
+static inline bool IsTokenChar(char ch)
+{
+    return !URLUtils::iscontrol(ch) && (ch & 0x80) == 0 && !URLUtils::isseperator(ch);
+}
+
+//! Creates a parser
+SHttpParser::SHttpParser(size_t maxLine) : maxLineLength(maxLine)
+{
+    Reset();
+}
+
+//! Resets the parser to expect a new request line
+void SHttpParser::Reset()
+{
+    currState   = STATE_REQUEST_LINE;
+    scanned     = 0;
+    colonOffset = 0;
+    colonFound  = false;
+}
+
+//! Makes the parser read header lines again (eg chunked trailers)
+void SHttpParser::ExpectTrailers()
+{
+    currState   = STATE_HEADERS;
+    scanned     = 0;
+    colonFound  = false;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Returns the first CR, LF or (optionally) ':' in the range or
+ *  pLast if none were found.
+ *
+ *  With SSE2 available 16 bytes are compared at a time.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+const char *SHttpParser::FindDelimiter(const char *pStart, const char *pLast, bool withColon)
+{
+    const char *pCurr = pStart;
+
+#ifdef __SSE2__
+    const __m128i cr    = _mm_set1_epi8(URLUtils::CR);
+    const __m128i lf    = _mm_set1_epi8(URLUtils::LF);
+    const __m128i colon = _mm_set1_epi8(withColon ? ':' : URLUtils::LF);
+
+    while (pLast - pCurr >= 16)
+    {
+        __m128i chunk   = _mm_loadu_si128((const __m128i *)pCurr);
+        __m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, cr),
+                                                    _mm_cmpeq_epi8(chunk, lf)),
+                                       _mm_cmpeq_epi8(chunk, colon));
+        int mask = _mm_movemask_epi8(matches);
+        if (mask != 0)
+            return pCurr + __builtin_ctz(mask);
+        pCurr += 16;
+    }
+#endif
+
+    for (;pCurr < pLast;pCurr++)
+    {
+        if (*pCurr == URLUtils::CR || *pCurr == URLUtils::LF || (withColon && *pCurr == ':'))
+            return pCurr;
+    }
+    return pLast;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Extracts the next complete line (without its terminator).
+ *
+ *  Returns 1 if a line was found (pStart is moved past it),
+ *  TOKEN_NEED_MORE if the line is incomplete (pStart is not moved) and
+ *  TOKEN_ERROR if the line is too long or badly terminated.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+int SHttpParser::NextLine(const char *&pStart, const char *pLast, SStringRef &line)
+{
+    // only look for colons in header lines and only till the first one
+    bool        withColon   = (currState == STATE_HEADERS);
+    const char *pCurr       = pStart + scanned;
+    const char *pEol        = NULL;
+
+    while (pEol == NULL)
+    {
+        pCurr = FindDelimiter(pCurr, pLast, withColon && !colonFound);
+        if (pCurr >= pLast)
+        {
+            scanned = pLast - pStart;
+            return scanned > maxLineLength ? TOKEN_ERROR : TOKEN_NEED_MORE;
+        }
+        else if (*pCurr == ':')
+        {
+            colonFound  = true;
+            colonOffset = pCurr - pStart;
+            pCurr++;
+        }
+        else
+        {
+            pEol = pCurr;
+        }
+    }
+
+    const char *pNext = pEol + 1;
+    if (*pEol == URLUtils::CR)
+    {
+        // a CR must be followed by an LF
+        if (pNext >= pLast)
+        {
+            scanned = pEol - pStart;
+            return TOKEN_NEED_MORE;
+        }
+        if (*pNext != URLUtils::LF)
+            return TOKEN_ERROR;
+        pNext++;
+    }
+
+    if ((size_t)(pEol - pStart) > maxLineLength)
+        return TOKEN_ERROR;
+
+    line    = SStringRef(pStart, pEol - pStart);
+    pStart  = pNext;
+    scanned = 0;
+    return 1;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Consumes the next line in the request head and returns the
+ *  kind of token that was on it.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+int SHttpParser::NextToken(const char *&pStart, const char *pLast)
+{
+    SStringRef line;
+
+    while (currState == STATE_REQUEST_LINE)
+    {
+        int result = NextLine(pStart, pLast, line);
+        if (result <= 0)
+            return result;
+
+        // be lenient about empty lines preceding a request
+        if (!line.Empty())
+            return ParseRequestLine(line);
+    }
+
+    if (currState != STATE_HEADERS)
+        return TOKEN_ERROR;
+
+    int result = NextLine(pStart, pLast, line);
+    if (result <= 0)
+        return result;
+
+    result      = ParseHeaderLine(line);
+    colonFound  = false;
+    return result;
+}
+
+//! Parses the request line - METHOD SP RESOURCE SP VERSION
+int SHttpParser::ParseRequestLine(const SStringRef &line)
+{
+    SStringRef *parts[3]    = { &method, &resource, &version };
+    const char *pCurr       = line.Data();
+    const char *pEnd        = line.End();
+
+    for (int i = 0;i < 3;i++)
+    {
+        while (pCurr < pEnd && isspace(*pCurr)) pCurr++;
+        const char *pTokStart = pCurr;
+        while (pCurr < pEnd && !isspace(*pCurr)) pCurr++;
+        if (pCurr == pTokStart)
+            return TOKEN_ERROR;
+        *(parts[i]) = SStringRef(pTokStart, pCurr - pTokStart);
+    }
+
+    while (pCurr < pEnd && isspace(*pCurr)) pCurr++;
+    if (pCurr != pEnd)
+        return TOKEN_ERROR;
+
+    currState = STATE_HEADERS;
+    return TOKEN_REQUEST_LINE;
+}
+
+//! Parses a header line whose colon was found while scanning for its end
+int SHttpParser::ParseHeaderLine(const SStringRef &line)
+{
+    if (line.Empty())
+    {
+        currState = STATE_DONE;
+        return TOKEN_HEADERS_DONE;
+    }
+
+    // folded header values start with whitespace
+    if (line[0] == ' ' || line[0] == '\t')
+    {
+        value = line.Trim();
+        return TOKEN_HEADER_CONTINUATION;
+    }
+
+    if (!colonFound || colonOffset == 0)
+        return TOKEN_ERROR;
+
+    const char *pName = line.Data();
+    for (size_t i = 0;i < colonOffset;i++)
+    {
+        if (!IsTokenChar(pName[i]))
+            return TOKEN_ERROR;
+    }
+
+    name    = SStringRef(pName, colonOffset);
+    value   = SStringRef(pName + colonOffset + 1, line.Size() - colonOffset - 1).Trim();
+    return TOKEN_HEADER;
+}
+
@@ -0,0 +1,130 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   parser.h
+ *
+ *  \brief  An incremental http request head parser that works directly
+ *  off a connection's read buffer.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#ifndef _SHTTP_PARSER_H_
+#define _SHTTP_PARSER_H_
+
+#include "utils/strref.h"
+#include "httpfwd.h"
+
+//*****************************************************************************
+/*!
+ *  \class  SHttpParser
+ *
+ *  \brief  Splits the request line and headers into tokens without
+ *  copying them.
+ *
+ *  The parser is fed whatever bytes are currently in the read buffer.
+ *  Each call to NextToken consumes at most one complete line and returns
+ *  what was found on it, with the token fields pointing into the buffer.
+ *  When only a partial line is available, NeedMore is returned and pStart
+ *  is left at the start of that line - the caller must keep the unconsumed
+ *  bytes (they may be moved, offsets are all the parser remembers) and call
+ *  again once more bytes have been appended.  Bytes already scanned are
+ *  not scanned again.
+ *
+ *****************************************************************************/
+class SHttpParser
+{
+public:
+    //! Tokens returned by NextToken
+    enum
+    {
+        TOKEN_ERROR                 = -1,   // malformed input
+        TOKEN_NEED_MORE             = 0,    // a partial line is pending
+        TOKEN_REQUEST_LINE,                 // method, resource and version are set
+        TOKEN_HEADER,                       // name and value are set
+        TOKEN_HEADER_CONTINUATION,          // value to be appended to the last header
+        TOKEN_HEADERS_DONE,                 // empty line ending the headers
+    };
+
+    //! Default limit on the length of a single line
+    const static size_t DEFAULT_MAX_LINE_LENGTH;
+
+public:
+    //! Creates a parser
+    SHttpParser(size_t maxLine = DEFAULT_MAX_LINE_LENGTH);
+
+    //! Resets the parser to expect a new request line
+    void Reset();
+
+    //! Makes the parser read header lines again (eg chunked trailers)
+    void ExpectTrailers();
+
+    //! Gets the next token out of the bytes in [pStart, pLast)
+    int NextToken(const char *&pStart, const char *pLast);
+
+    //! Gets the next complete line out of the bytes in [pStart, pLast)
+    int NextLine(const char *&pStart, const char *pLast, SStringRef &line);
+
+    //! Finds the first CR or LF (or ':' if requested) in [pStart, pLast)
+    static const char *FindDelimiter(const char *pStart, const char *pLast, bool withColon);
+
+public:
+    //! Request line tokens
+    SStringRef  method;
+    SStringRef  resource;
+    SStringRef  version;
+
+    //! Header tokens
+    SStringRef  name;
+    SStringRef  value;
+
+protected:
+    //! Parses the request line
+    int ParseRequestLine(const SStringRef &line);
+
+    //! Parses a header line whose colon (if any) is at colonOffset
+    int ParseHeaderLine(const SStringRef &line);
+
+protected:
+    //! Where in the request head we are
+    enum
+    {
+        STATE_REQUEST_LINE,
+        STATE_HEADERS,
+        STATE_DONE,
+    };
+
+    //! Current state
+    int         currState;
+
+    //! Bytes of the pending line that have already been scanned
+    size_t      scanned;
+
+    //! Offset of the first colon in the pending line (if one was found)
+    size_t      colonOffset;
+
+    //! Whether colonOffset is valid
+    bool        colonFound;
+
+    //! Maximum length of a line
+    size_t      maxLineLength;
+};
+
+#endif
+
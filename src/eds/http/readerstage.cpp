@@ -25,9 +25,14 @@
  *****************************************************************************/
 
 #include "request.h"
+#include "response.h"
+#include "parser.h"
 #include "../connection.h"
+#include "../server.h"
 #include "readerstage.h"
 #include "handlerstage.h"
+#include "writerstage.h"
+#include "httpmodule.h"
 
 #include <arpa/inet.h>
 #include <sys/types.h>
@@ -35,6 +40,7 @@
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <stdio.h>
+#include <ctype.h>
 #include <errno.h>
 
 // data and state stored by the request reader
@@ -48,70 +54,164 @@ public:
         READING_BODY,
         READING_CHUNK_SIZE,
         READING_CHUNK_BODY,
+        READING_CHUNK_END,
+        READING_TRAILERS,
     };
 
 public:
-    SHttpReaderState()
+    SHttpReaderState(SHttpReaderStage *pStage) :
+        pCurrRequest(NULL),
+        pCurrBodyPart(NULL),
+        pReaderStage(pStage)
     {
         Reset();
     }
 
 
-    // Destroys the request data - Request object to be 
-    // deleted by later stages
+    // Destroys the request data - requests are only ever referred to
+    // by later stages so they are destroyed here
     ~SHttpReaderState()
     {
+        if (pCurrBodyPart != NULL)
+            delete pCurrBodyPart;
+        for (size_t i = 0;i < requests.size();i++)
+            delete requests[i];
     }
 
+    // Resets the state for a new batch of (pipelined) requests
     void Reset()
     {
-        // reset reader state
+        numParsed           = 0;
+        numDispatched       = 0;
+        pLastDispatched     = NULL;
+        lastHandled         = false;
+        dispatching         = false;
+        pendingBody         = 0;
+        readPaused          = false;
+        StartRequest(0);
+    }
+
+    // Resets the state to read a request into the given slot
+    void StartRequest(size_t slot)
+    {
+        // drop the body of a request that was never completed
+        if (pCurrBodyPart != NULL)
+            delete pCurrBodyPart;
+
         currState           = READING_FIRST_LINE;
         pCurrBodyPart       = NULL;
         currBodySize        = 0;
         currBodyRead        = 0;
+        totalBodyRead       = 0;
+        pBodyModule         = NULL;
         requestFullyRead    = false;
-        pCurrRequest.Reset();
+        bodyTooLarge        = false;
+        lastHeaderName.clear();
+        parser.Reset();
+
+        if (slot >= requests.size())
+            requests.push_back(new SHttpRequest());
+        pCurrRequest = requests[slot];
+        pCurrRequest->Reset();
     }
 
 public:
     bool ProcessBytes(char *&pStart, char *&pLast);
 
-    bool ProcessCurrentLine();
+    bool ProcessToken(int token);
 
     bool ProcessBodyData(char *&pStart, char *&pLast);
 
+    bool ProcessChunkLine(const SStringRef &line);
+
+    void StartBody();
+
+    bool ExpectsContinue();
+
+    bool ExceedsMaxBody(off_t length);
+
+    void RejectBody(SConnection *pConnection);
+
+    void SendBodyPart(SBodyPart *pBodyPart);
+
+    void FinishBody();
+
+    void ParseAhead(SConnection *pConnection, char *&pStart, char *&pLast);
+
 public:
     //! Current state
     int                 currState;
 
-    //! Current header being read
-    SStringStream       currHeaderLine;
+    //! Tokenises the request line and headers in place
+    SHttpParser         parser;
+
+    //! Name of the last header read (for folded header values)
+    SString             lastHeaderName;
 
     //! Current request being read
-    SHttpRequest        pCurrRequest;
+    SHttpRequest *      pCurrRequest;
+
+    //! Request objects for pipelined requests - reused for each batch
+    std::vector<SHttpRequest *> requests;
+
+    //! Number of requests read in the current batch
+    size_t              numParsed;
+
+    //! Number of requests sent to the handler in the current batch
+    size_t              numDispatched;
+
+    //! The request last sent to the handler (NULL before the first of a batch)
+    SHttpRequest *      pLastDispatched;
+
+    //! Whether the response to the last dispatched request has been produced
+    bool                lastHandled;
+
+    //! Set while requests are being dispatched
+    bool                dispatching;
+
+    //! Guards the dispatch counters and flags
+    SMutex              pipelineMutex;
 
     //! Current body part being read
-    SRawBodyPart *      pCurrBodyPart;
+    SBodyPart *         pCurrBodyPart;
 
     //! Size of the current body or chunk
-    unsigned            currBodySize;
+    off_t               currBodySize;
 
     //! Number of bytes read in the current body or chunk
-    unsigned            currBodyRead;
+    off_t               currBodyRead;
+
+    //! Number of body bytes read across all chunks
+    off_t               totalBodyRead;
+
+    //! The stage this state belongs to
+    SHttpReaderStage *  pReaderStage;
+
+    //! Module the body is being streamed to (if any)
+    SHttpModule *       pBodyModule;
 
-    //! Current line being accumulated
-    SStringStream       currentLine;
+    //! Bytes of the streamed body not yet consumed by pBodyModule
+    size_t              pendingBody;
+
+    //! Set when reading stops till more of the streamed body is consumed
+    bool                readPaused;
 
     //! Set to true when a request has been read
     bool                requestFullyRead;
+
+    //! Set when the body is found to be larger than allowed
+    bool                bodyTooLarge;
 };
 
 // Creates a new file io helper stage
 SHttpReaderStage::SHttpReaderStage(const SString &name, int numThreads)
 :
     SReaderStage(name, numThreads),
-    pHandlerStage(NULL)
+    pHandlerStage(NULL),
+    maxBodySize(0),
+    maxPendingBody(65536),
+    maxPipelinedRequests(8),
+    spoolThreshold(0)
 {
 }
 
@@ -123,7 +223,7 @@ SHttpReaderStage::~SHttpReaderStage()
 //! Creates a new reader state object
 void *SHttpReaderStage::CreateStageData()
 {
-    return new SHttpReaderState();
+    return new SHttpReaderState(this);
 }
 
 //! Destroys reader state objects
@@ -139,98 +239,204 @@ void SHttpReaderStage::ResetStageData(void *pData)
     ((SHttpReaderState *)pData)->Reset();
 }
 
+//! Called when a module has consumed bytes of a streamed body
+bool SHttpReaderStage::SendEvent_BodyConsumed(SConnection *pConnection, size_t numBytes)
+{
+    return QueueEvent(SEvent(EVT_BODY_CONSUMED, pConnection, (void *)numBytes));
+}
+
+//! Called when the response to the last dispatched request has been produced
+bool SHttpReaderStage::SendEvent_RequestHandled(SConnection *pConnection, SHttpRequest *pRequest)
+{
+    return QueueEvent(SEvent(EVT_REQUEST_HANDLED, pConnection, pRequest));
+}
+
+//! Handles body consumed and request handled events and passes the rest on
+void SHttpReaderStage::HandleEvent(const SEvent &event)
+{
+    if (event.evType != EVT_BODY_CONSUMED && event.evType != EVT_REQUEST_HANDLED)
+    {
+        SReaderStage::HandleEvent(event);
+        return ;
+    }
+
+    SConnection *       pConnection     = (SConnection *)(event.pSource);
+    SHttpReaderState *  pReaderState    = (SHttpReaderState *)pConnection->GetStageData(this);
+
+    if (event.evType == EVT_REQUEST_HANDLED)
+    {
+        // only the request most recently dispatched can release the next
+        // one - anything else is left over from an earlier batch
+        SHttpRequest *pRequest = event.Data<SHttpRequest *>();
+        pReaderState->pipelineMutex.Lock();
+        if (pRequest != NULL && pRequest == pReaderState->pLastDispatched)
+        {
+            pReaderState->lastHandled       = true;
+            pReaderState->pLastDispatched   = NULL;
+        }
+        pReaderState->pipelineMutex.Unlock();
+        DispatchRequests(pConnection, pReaderState);
+        return ;
+    }
+    size_t              numBytes        = event.Data<size_t>();
+
+    assert("More bytes consumed than were sent" && numBytes <= pReaderState->pendingBody);
+    pReaderState->pendingBody -= numBytes;
+
+    // resume reading if we had stopped to let the module catch up
+    if (pReaderState->readPaused && pReaderState->pendingBody < maxPendingBody)
+    {
+        pReaderState->readPaused = false;
+        HandleReadRequestEvent(event);
+    }
+}
+
+//! Tells if reading is paused till a streamed body is consumed
+bool SHttpReaderStage::ReadPaused(SConnection *pConnection, void *pState)
+{
+    return ((SHttpReaderState *)pState)->readPaused;
+}
+
 //! Handle the new assembled request
 bool SHttpReaderStage::HandleRequest(SConnection *pConnection, void *pRequest)
 {
-    ((SHttpRequest *)pRequest)->SetConnection(pConnection);
+    SHttpRequest *pHttpRequest = (SHttpRequest *)pRequest;
+
+    // a streamed request has already been sent to the handler, so just
+    // see if its response was finished while the body was being read
+    if (pHttpRequest->BodyStreamed())
+    {
+        if (pHttpRequest->FinishStreamedRequest())
+            pConnection->Server()->SetConnectionState(pConnection, SConnection::STATE_FINISHED);
+        return true;
+    }
 
-    // send the request off to the handler stage
-    return pHandlerStage->SendEvent_HandleNextRequest(pConnection, (SHttpRequest *)pRequest);
+    // send the request (and any pipelined behind it) off to the handler stage
+    DispatchRequests(pConnection, (SHttpReaderState *)pConnection->GetStageData(this));
+    return true;
+}
+
+//! Sends the next of the parsed requests to the handler once the response
+// to the one before it has been produced.  Since handlers keep per
+// connection data, only one request is with the handler at a time, but
+// the next is sent without waiting for the response to be written out.
+void SHttpReaderStage::DispatchRequests(SConnection *pConnection, SHttpReaderState *pReaderState)
+{
+    SHttpRequest *pNext = NULL;
+
+    pReaderState->pipelineMutex.Lock();
+    if (!pReaderState->dispatching)
+    {
+        pReaderState->dispatching = true;
+        while (pReaderState->numDispatched < pReaderState->numParsed &&
+               (pReaderState->numDispatched == 0 || pReaderState->lastHandled))
+        {
+            pNext = pReaderState->requests[pReaderState->numDispatched++];
+            pReaderState->pLastDispatched   = pNext;
+            pReaderState->lastHandled       = false;
+
+            // the handler may finish the request (and ask for the next) right
+            // away, which is picked up by this loop instead of recursing
+            pReaderState->pipelineMutex.Unlock();
+            pHandlerStage->SendEvent_HandleNextRequest(pConnection, pNext);
+            pReaderState->pipelineMutex.Lock();
+        }
+        pReaderState->dispatching = false;
+    }
+    pReaderState->pipelineMutex.Unlock();
 }
 
 //! Process a bunch of bytes and try to assemble a request if enough bytes found
-void *SHttpReaderStage::AssembleRequest(char *&pStart, char *&pLast, void *pState)
+void *SHttpReaderStage::AssembleRequest(SConnection *pConnection, char *&pStart, char *&pLast, void *pState)
 {
     SHttpReaderState *  pReaderState    = (SHttpReaderState *)pState;
     SHttpRequest *      pOut            = NULL;
 
+    pReaderState->pCurrRequest->SetConnection(pConnection);
     if (pReaderState->ProcessBytes(pStart, pLast))
     {
         if (pReaderState->requestFullyRead)
         {
-            pOut = &(pReaderState->pCurrRequest);
+            pOut = pReaderState->pCurrRequest;
+
+            // read ahead any complete requests pipelined behind this one
+            if (!pOut->BodyStreamed())
+            {
+                pReaderState->numParsed = 1;
+                pReaderState->ParseAhead(pConnection, pStart, pLast);
+            }
         }
     }
+    else if (pReaderState->bodyTooLarge && !pReaderState->pCurrRequest->BodyStreamed())
+    {
+        // nothing has been sent for the request yet so the client can be
+        // told why before the connection is closed
+        pReaderState->RejectBody(pConnection);
+    }
     else
     {
-        // we have an error??
+        SLogger::Get()->Log("ERROR: Malformed request on connection [%x], closing\n", pConnection);
+        pConnection->Server()->SetConnectionState(pConnection, SConnection::STATE_CLOSED);
     }
     return pOut;
 }
 
+//! Consumes bytes till a request has been read or more bytes are needed.
+// Returns false on malformed input.  Partial lines are left unconsumed (at
+// pStart) so the reader stage can read in the rest behind them.
 bool SHttpReaderState::ProcessBytes(char *&pStart, char *&pLast)
 {
-    char *pCurr   = pStart;
-    while (pCurr < pLast)
+    while (!requestFullyRead && !readPaused)
     {
-        while (pCurr < pLast && 
-                (currState == READING_FIRST_LINE ||
-                currState == READING_HEADERS ||
-                currState == READING_CHUNK_SIZE))
+        if (currState == READING_FIRST_LINE || currState == READING_HEADERS ||
+            currState == READING_TRAILERS)
         {
-            // TODO: do all the single-line bits in a single pass instead of two
-            // go to the first CRLF or LF
-            while ((pCurr < pLast) && (*pCurr != URLUtils::CR) && (*pCurr != URLUtils::LF)) pCurr++;
+            const char *pCurr   = pStart;
+            int token           = parser.NextToken(pCurr, pLast);
+            pStart              = const_cast<char *>(pCurr);
 
-            currentLine << SString(pStart, pCurr - pStart);
-            if (*pCurr == URLUtils::CR)
-            {
-                pCurr += 2;
-            }
-            else if (*pCurr == URLUtils::LF)
-            {
-                pCurr++;
-            }
-            else
-            {
-                // no more bytes left so leave 
-                pStart = pCurr;
+            if (token == SHttpParser::TOKEN_NEED_MORE)
                 return true;
-            }
-
-            if (!ProcessCurrentLine())
-            {
-                // error so just quit
+            else if (!ProcessToken(token))
                 return false;
-            }
-
-            // point to start of next line
-            pStart = pCurr;
+            else if (token == SHttpParser::TOKEN_HEADERS_DONE && currState != READING_TRAILERS)
+                StartBody();
         }
-
-        if (currState == READING_BODY || currState == READING_CHUNK_BODY)
+        else if (currState == READING_CHUNK_SIZE || currState == READING_CHUNK_END)
         {
-            pStart = pCurr;
-            // if (pLast <= pStart) return false;
+            SStringRef  line;
+            const char *pCurr   = pStart;
+            int result          = parser.NextLine(pCurr, pLast, line);
+            pStart              = const_cast<char *>(pCurr);
 
+            if (result == SHttpParser::TOKEN_NEED_MORE)
+                return true;
+            else if (result < 0 || !ProcessChunkLine(line))
+                return false;
+        }
+        else
+        {
             // if error in ready body data then quit
             if (!ProcessBodyData(pStart, pLast))
                 return false;
-            else if (requestFullyRead)
+            else if (pStart >= pLast)
                 return true;
         }
     }
-    return false;
+    return true;
 }
 
 // Reads body data and returns the number of bytes processed
 bool SHttpReaderState::ProcessBodyData(char *&pStart, char *&pLast)
 {
-    // length of the content
-    size_t contLength = 0;
+    // length of the content - bodies (and so these counts) can be past 4GB
+    off_t contLength = 0;
     if (currState == READING_BODY)
     {
-        contLength = pCurrRequest.ContentLength();
+        off_t length = pCurrRequest->ContentLength();
+        if (length < 0 || ExceedsMaxBody(length))
+            return false;
+        contLength = length;
         currBodySize = contLength;
     }
     else
@@ -239,33 +445,65 @@ bool SHttpReaderState::ProcessBodyData(char *&pStart, char *&pLast)
     }
 
     // how much do we need to read?
-    size_t currBodyLeft = contLength - currBodyRead;
+    off_t currBodyLeft = contLength - currBodyRead;
 
     // how much SHOULD we read?  we only want to read what ever of 
     // the body is left, despite how much is passed to this method
-    size_t minLength    = ((pStart + currBodyLeft) < pLast) ? currBodyLeft : (pLast - pStart);
+    size_t available    = pLast - pStart;
+    size_t minLength    = currBodyLeft < (off_t)available ? (size_t)currBodyLeft : available;
     if (minLength < 0)
     {
         // how can this be?
         assert("Why is minLength <= 0???" && false);
     }
+    else if (pBodyModule != NULL)
+    {
+        // only send as much as the module is willing to have pending
+        size_t maxPending = pReaderStage->GetMaxPendingBody();
+        if (pendingBody >= maxPending)
+        {
+            readPaused = true;
+            return true;
+        }
+        else if (minLength > maxPending - pendingBody)
+        {
+            minLength = maxPending - pendingBody;
+        }
+
+        if (minLength > 0)
+        {
+            SRawBodyPart *pBodyPart = pCurrRequest->NewRawBodyPart();
+            pBodyPart->AppendToBody(pStart, minLength);
+            pendingBody += minLength;
+            SendBodyPart(pBodyPart);
+        }
+    }
     else if (minLength > 0)
     {
-        if (pCurrBodyPart == NULL)
-            pCurrBodyPart = pCurrRequest.NewRawBodyPart();
-        pCurrBodyPart->AppendToBody(pStart, minLength);
+        size_t spoolThreshold = pReaderStage->GetSpoolThreshold();
+        if (spoolThreshold == 0)
+        {
+            if (pCurrBodyPart == NULL)
+                pCurrBodyPart = pCurrRequest->NewRawBodyPart();
+            ((SRawBodyPart *)pCurrBodyPart)->AppendToBody(pStart, minLength);
+        }
+        else
+        {
+            if (pCurrBodyPart == NULL)
+                pCurrBodyPart = pCurrRequest->NewSpooledBodyPart(spoolThreshold);
+            if (!((SSpooledBodyPart *)pCurrBodyPart)->AppendToBody(pStart, minLength))
+                return false;
+        }
     }
 
     currBodyRead    += minLength;  // increment what has been read
+    totalBodyRead   += minLength;
     if (currBodyRead == currBodySize)
     {
-        if (currState == READING_BODY ||
-            (currState == READING_CHUNK_BODY && currBodySize == 0))
-        {
-            // done add requests to the list of requests
-            pCurrRequest.SetContentBody(pCurrBodyPart);
-            requestFullyRead = true;
-        }
+        if (currState == READING_BODY)
+            FinishBody();
+        else
+            currState = READING_CHUNK_END;
     }
 
     // incrementing the curr buff position
@@ -274,96 +512,244 @@ bool SHttpReaderState::ProcessBodyData(char *&pStart, char *&pLast)
     return true;
 }
 
-// Processes the current line
-// returns 0 on success, 1 if success and complete
-// -1 if failure
-bool SHttpReaderState::ProcessCurrentLine()
+// Processes a token from the request line or headers - the tokens
+// point into the read buffer so they are copied out here if needed.
+bool SHttpReaderState::ProcessToken(int token)
 {
-    // create a request if none found
-    // if (pCurrRequest == NULL) pCurrRequest = new SHttpRequest();
-
-    SString currLine(currentLine.str());
+    SHeaderTable &headers   = pCurrRequest->Headers();
 
-    if (currState == READING_FIRST_LINE)
-    {
-        if (!pCurrRequest.ParseFirstLine(currLine))
-            return false;
+    // trailers never change the headers the request was checked against
+    SHeaderTable &fields    = currState == READING_TRAILERS ? pCurrRequest->Trailers() : headers;
 
-        currHeaderLine.str("");
-        currHeaderLine.clear();
-        currState = READING_HEADERS;
-    }
-    else if (currState == READING_CHUNK_SIZE)
+    switch (token)
     {
-        assert("Chunk reading not yet done." &&  false);
-
-        // TODO: Set currBodySize to parsed chunk size 
-        // and currBodyRead to 0
-        currBodySize  = currBodyRead  = 0;
+        case SHttpParser::TOKEN_REQUEST_LINE:
+            pCurrRequest->SetRequestLine(parser.method, parser.resource, parser.version);
+            currState = READING_HEADERS;
+            return true;
+
+        case SHttpParser::TOKEN_HEADER:
+            lastHeaderName.assign(parser.name.Data(), parser.name.Size());
+            fields.SetHeader(lastHeaderName, parser.value.Str());
+            return true;
+
+        case SHttpParser::TOKEN_HEADER_CONTINUATION:
+            if (lastHeaderName.empty())
+                return false;
+            fields.SetHeader(lastHeaderName, fields.Header(lastHeaderName) + " " + parser.value.Str());
+            return true;
 
-        // read the chunk body
-        currState = READING_CHUNK_BODY;
-    }
-    else if (currState == READING_HEADERS)
-    {
-        if (!currLine.empty() && isspace(currLine[0]))
+        case SHttpParser::TOKEN_HEADERS_DONE:
         {
-            // append to previous line
-            currHeaderLine << currLine;
-        }
-        else
-        {
-            // we have a valid header, so add the last header to our
-            // list (if it wasnt empty)
-            SString lastHeader(currHeaderLine.str());
-            if ( ! lastHeader.empty())
+            currBodySize  = currBodyRead  = 0;
+
+            // end of the trailers after the last chunk
+            if (currState == READING_TRAILERS)
             {
-                SString hdrName, hdrValue;
-                SHeaderTable &pHeaders = pCurrRequest.Headers();
-                if (!pHeaders.ParseHeaderLine(lastHeader, hdrName, hdrValue))
-                    return false;
+                // downstream only ever sees the decoded body
+                headers.RemoveHeader(HDR_TRANSFER_ENCODING);
+                headers.SetContentLength(totalBodyRead);
+                FinishBody();
+                return true;
             }
 
-            currHeaderLine.str("");
-            currHeaderLine.clear();
-
-            // what do we do weith current line?
-
-            if (currLine.empty())
+            // see if we are doing chunked encoding or not
+            const SString *pTransferEncoding = headers.HeaderValue(HDR_TRANSFER_ENCODING);
+            if (pTransferEncoding != NULL)
             {
-                currBodySize  = currBodyRead  = 0;
-
-                // see if we are doing chunked encoding or not
-                SString transferEncoding;
-                if (pCurrRequest.Headers().HeaderIfExists("Transfer-Encoding", transferEncoding))
+                if (strcasecmp(pTransferEncoding->c_str(), "chunked") == 0)
                 {
-                    if (strcasecmp(transferEncoding.c_str(), "chunked") == 0)
-                    {
-                        currState = READING_CHUNK_SIZE;
-                    }
-                    else
-                    {
-                        // TODO: Support for other transfer encodings
-                        // Perhaps send all chunks to the TransferModule and
-                        // let it do all the assembly?
-                        return false;
-                    }
+                    currState = READING_CHUNK_SIZE;
                 }
                 else
                 {
-                    currState = READING_BODY;
+                    // TODO: Support for other transfer encodings
+                    // Perhaps send all chunks to the TransferModule and
+                    // let it do all the assembly?
+                    return false;
                 }
             }
             else
             {
-                currHeaderLine << currLine;
+                currState = READING_BODY;
             }
+            return true;
         }
     }
 
-    currentLine.str("");
-    currentLine.clear();
+    return false;
+}
+
+// Handles the chunk size line before each chunk and the empty line after
+// each chunk's data.  Chunk extensions are ignored.
+bool SHttpReaderState::ProcessChunkLine(const SStringRef &line)
+{
+    if (currState == READING_CHUNK_END)
+    {
+        if (!line.Empty())
+            return false;
+        currState = READING_CHUNK_SIZE;
+        return true;
+    }
+
+    const char *pCurr   = line.Data();
+    const char *pEnd    = line.End();
+    off_t chunkSize     = 0;
+    int numDigits       = 0;
+    for (;pCurr < pEnd && isxdigit(*pCurr);pCurr++, numDigits++)
+    {
+        // guard against sizes that would overflow
+        if (numDigits >= 15)
+            return false;
+        char ch = tolower(*pCurr);
+        chunkSize = (chunkSize << 4) | (isdigit(ch) ? ch - '0' : ch - 'a' + 10);
+    }
+
+    while (pCurr < pEnd && (*pCurr == ' ' || *pCurr == '\t')) pCurr++;
+    if (numDigits == 0 || (pCurr < pEnd && *pCurr != ';'))
+        return false;
+
+    if (ExceedsMaxBody(totalBodyRead + chunkSize))
+        return false;
 
+    if (chunkSize == 0)
+    {
+        // last chunk - trailers follow
+        lastHeaderName.clear();
+        currState = READING_TRAILERS;
+        parser.ExpectTrailers();
+    }
+    else
+    {
+        currBodySize    = chunkSize;
+        currBodyRead    = 0;
+        currState       = READING_CHUNK_BODY;
+    }
     return true;
 }
 
+// Reads in further complete requests that are already in the buffer (upto
+// the pipelining limit) so each can be handled as soon as the one before
+// it is.  An incomplete or bad request is left in the buffer to be read
+// again once the current batch is done.
+void SHttpReaderState::ParseAhead(SConnection *pConnection, char *&pStart, char *&pLast)
+{
+    size_t maxRequests = pReaderStage->GetMaxPipelinedRequests();
+    while (numParsed < maxRequests && pStart < pLast)
+    {
+        char *          pRequestStart   = pStart;
+        SHttpRequest *  pPrevRequest    = pCurrRequest;
+
+        // nothing after a request that closes the connection is handled
+        if (pPrevRequest->Headers().CloseConnection())
+            break ;
+
+        StartRequest(numParsed);
+        pCurrRequest->SetConnection(pConnection);
+        if (!ProcessBytes(pStart, pLast) || !requestFullyRead)
+        {
+            pStart = pRequestStart;
+            break ;
+        }
+
+        pPrevRequest->SetNextRequest(pCurrRequest);
+        numParsed++;
+    }
+}
+
+// Called at the end of the headers to see if a module wants the body
+// streamed to it.  If so the request is handed off right away.
+void SHttpReaderState::StartBody()
+{
+    SHttpHandlerStage *pHandlerStage = pReaderStage->GetHandlerStage();
+    if (currState == READING_BODY && pCurrRequest->ContentLength() <= 0)
+        return ;
+
+    // a body that is too large is refused before anything is done with it
+    if (currState == READING_BODY && ExceedsMaxBody(pCurrRequest->ContentLength()))
+        return ;
+
+    // pipelined requests are only read from what is already buffered
+    if (numParsed > 0)
+        return ;
+
+    if (ExpectsContinue())
+    {
+        if (!pHandlerStage->AcceptRequestBody(pCurrRequest))
+        {
+            // the module responds without the body, which is never read,
+            // so the connection cannot be used for more requests
+            pCurrRequest->SetBodyDeclined(true);
+            pCurrRequest->Headers().SetHeader(HDR_CONNECTION, "close");
+            requestFullyRead = true;
+            return ;
+        }
+
+        // let the client know it can go ahead with the body - this goes
+        // through the writer so it is not mixed up with other writes
+        pHandlerStage->GetWriterStage()->SendEvent_WriteContinue(pCurrRequest->Connection());
+    }
+
+    pBodyModule = pHandlerStage->RequestBodyModule(pCurrRequest);
+    if (pBodyModule != NULL)
+    {
+        pCurrRequest->SetBodyStreamed(true);
+        numParsed = numDispatched = 1;
+        pHandlerStage->SendEvent_HandleNextRequest(pCurrRequest->Connection(), pCurrRequest);
+    }
+}
+
+// Tells if the client is waiting for a 100 Continue before sending the
+// body.  Other expectations are ignored as are those from HTTP/1.0 clients.
+bool SHttpReaderState::ExpectsContinue()
+{
+    const SString *pExpect = pCurrRequest->Headers().HeaderValue(HDR_EXPECT);
+    return pExpect != NULL &&
+           strcasecmp(pExpect->c_str(), "100-continue") == 0 &&
+           strcasecmp(pCurrRequest->Version().c_str(), "HTTP/1.0") != 0;
+}
+
+// Tells if a body of the given length is larger than allowed (and notes
+// it so the request can be refused)
+bool SHttpReaderState::ExceedsMaxBody(off_t length)
+{
+    size_t maxBodySize = pReaderStage->GetMaxBodySize();
+    if (maxBodySize > 0 && (unsigned long long)length > maxBodySize)
+        bodyTooLarge = true;
+    return bodyTooLarge;
+}
+
+// Refuses a request whose body is too large with a 413 and closes the
+// connection once it has been written, as the rest of the body is never
+// read.  Only the first request of a batch is refused (later ones are
+// read again once the batch is done) so no other response is in the way.
+void SHttpReaderState::RejectBody(SConnection *pConnection)
+{
+    SLogger::Get()->Log("ERROR: Request body too large on connection [%x], closing\n", pConnection);
+
+    SHttpResponse *pResponse = pCurrRequest->Response();
+    pResponse->SetStatus(413, "Request Entity Too Large");
+    pResponse->Headers().SetContentLength(0);
+    pCurrRequest->Headers().SetHeader(HDR_CONNECTION, "close");
+    pConnection->Server()->SetConnectionState(pConnection, SConnection::STATE_PROCESSING);
+    pReaderStage->GetHandlerStage()->SendEvent_WriteBodyPart(pConnection, pCurrRequest,
+                                                             pResponse->NewContFinishedPart(NULL));
+}
+
+// Sends a part of a streamed body to the module consuming it
+void SHttpReaderState::SendBodyPart(SBodyPart *pBodyPart)
+{
+    pReaderStage->GetHandlerStage()->SendEvent_InputToModule(pCurrRequest->Connection(), pBodyModule, pBodyPart);
+}
+
+// Hands the body read so far to the request (or tells the streaming
+// module that the body is finished)
+void SHttpReaderState::FinishBody()
+{
+    if (pBodyModule != NULL)
+        SendBodyPart(pCurrRequest->NewContFinishedPart(pBodyModule));
+    else
+        pCurrRequest->SetContentBody(pCurrBodyPart);
+    pCurrBodyPart       = NULL;
+    requestFullyRead    = true;
+}
@@ -45,6 +45,8 @@ public:
     typedef enum
     {
         EVT_BYTES_RECIEVED = 0,
+        EVT_BODY_CONSUMED,
+        EVT_REQUEST_HANDLED,
     } EventType;
 
 public:
@@ -60,7 +62,46 @@ public:
     //! Get the handler stage
     virtual SHttpHandlerStage *GetHandlerStage() { return pHandlerStage; }
 
+    //! Sets the largest request body accepted (0 for no limit)
+    virtual void    SetMaxBodySize(size_t maxSize) { maxBodySize = maxSize; }
+
+    //! Gets the largest request body accepted
+    virtual size_t  GetMaxBodySize() { return maxBodySize; }
+
+    //! Sets how many bytes of a streamed body can be waiting to be
+    // consumed by a module before reading is paused
+    virtual void    SetMaxPendingBody(size_t maxPending) { maxPendingBody = maxPending; }
+
+    //! Gets how many bytes of a streamed body can be pending
+    virtual size_t  GetMaxPendingBody() { return maxPendingBody; }
+
+    //! Sets how many complete requests already in the read buffer are
+    // read in together so they can be handled back to back
+    virtual void    SetMaxPipelinedRequests(size_t maxRequests) { maxPipelinedRequests = maxRequests < 1 ? 1 : maxRequests; }
+
+    //! Gets how many pipelined requests are read in together
+    virtual size_t  GetMaxPipelinedRequests() { return maxPipelinedRequests; }
+
+    //! Sets the size past which request bodies are spooled to a temporary
+    // file (0 to always keep them in memory)
+    virtual void    SetSpoolThreshold(size_t threshold) { spoolThreshold = threshold; }
+
+    //! Gets the size past which request bodies are spooled
+    virtual size_t  GetSpoolThreshold() { return spoolThreshold; }
+
+    //! Called when a module has consumed bytes of a streamed body
+    virtual bool    SendEvent_BodyConsumed(SConnection *pConnection, size_t numBytes);
+
+    //! Called when the response to the last dispatched request has been produced
+    virtual bool    SendEvent_RequestHandled(SConnection *pConnection, SHttpRequest *pRequest);
+
 protected:
+    //! Handles body consumed events and passes the rest on
+    virtual void    HandleEvent(const SEvent &event);
+
+    //! Tells if reading is paused till a streamed body is consumed
+    virtual bool    ReadPaused(SConnection *pConnection, void *pState);
+
     //! Creates the state specific object
     virtual void *  CreateStageData();
 
@@ -71,14 +112,29 @@ protected:
     virtual void    ResetStageData(void *pData);
 
     //! Tries to assemble the request object from a byte buffer
-    virtual void *  AssembleRequest(char *&pStart, char *&pLast, void *pState);
+    virtual void *  AssembleRequest(SConnection *pConnection, char *&pStart, char *&pLast, void *pState);
 
     //! Handles the newly assembled request
     virtual bool    HandleRequest(SConnection *pConnection, void *pRequest);
 
+    //! Sends parsed requests to the handler one after the other
+    virtual void    DispatchRequests(SConnection *pConnection, SHttpReaderState *pReaderState);
+
 private:
     //! The request handler stage which handles assembled requests
     SHttpHandlerStage *pHandlerStage;
+
+    //! Largest request body accepted (0 for no limit)
+    size_t              maxBodySize;
+
+    //! Most bytes of a streamed body that can be pending
+    size_t              maxPendingBody;
+
+    //! Most requests read in together from the buffer
+    size_t              maxPipelinedRequests;
+
+    //! Size past which bodies are spooled to disk
+    size_t              spoolThreshold;
 };
 
 #endif
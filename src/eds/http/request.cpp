@@ -37,8 +37,18 @@ SHttpRequest::SHttpRequest(SConnection *pConn) :
     host(""),
     port(80),
     method("GET"),
+    pathStart(0),
+    pathLength(0),
+    queryStart(SString::npos),
     resource("/"),
+    resourceDecoded(true),
+    queryIndexed(true),
     pContentBody(NULL),
+    bodyStreamed(false),
+    bodyDeclined(false),
+    streamFinishCount(0),
+    pNextRequest(NULL),
+    pPrevRequest(NULL),
     pConnection(pConn),
     pResponse(new SHttpResponse())
 {
@@ -48,8 +58,15 @@ SHttpRequest::SHttpRequest(SConnection *pConn) :
 void SHttpRequest::Reset(SConnection *pConn)
 {
     SHttpMessage::Reset();
-    if (pContentBody)
-        pContentBody->Reset();
+    // the body may be holding on to a spool file so let it go
+    SetContentBody(NULL);
+    trailers.Reset();
+
+    bodyStreamed        = false;
+    bodyDeclined        = false;
+    streamFinishCount   = 0;
+    pNextRequest        = NULL;
+    pPrevRequest        = NULL;
 
     if (pResponse)
         pResponse->Reset();
@@ -73,6 +90,13 @@ SHttpRequest::~SHttpRequest()
     }
 }
 
+//! Called by the reader and the writer when done with a streamed request
+bool SHttpRequest::FinishStreamedRequest()
+{
+    SMutexLock locker(streamMutex);
+    return ++streamFinishCount == 2;
+}
+
 // Gets the host
 const SString &SHttpRequest::Host() const
 {
@@ -100,19 +124,31 @@ void SHttpRequest::SetMethod(const SString &m)
 // Gets the method Resource
 const SString &SHttpRequest::Resource() const
 {
+    if (!resourceDecoded)
+    {
+        resource.clear();
+        URLUtils::Unescape(realResource.data() + pathStart, pathLength, resource);
+        resourceDecoded = true;
+    }
     return resource;
 }
 
-// Sets the request Resource
+// Sets the request Resource.  Only the scheme, host and port are pulled
+// out here - the path and query are unescaped when they are asked for.
 void SHttpRequest::SetResource(const SString &r)
 {
     realResource                = r;
-    const char *pStart          = r.c_str();
-    const char *pEnd            = pStart + r.size();
+    const char *pBase           = realResource.c_str();
+    const char *pStart          = pBase;
 
     // set defaults
-    port        = 80;
-    queryValues.clear();
+    port            = 80;
+    pathStart       = 0;
+    pathLength      = 0;
+    queryStart      = SString::npos;
+    resource.clear();
+    resourceDecoded = true;
+    queryIndexed    = false;
 
     // remove the scheme out - eg http:// or https://
     const char *pColSlashSlash  = strstr(pStart, "://");
@@ -133,7 +169,6 @@ void SHttpRequest::SetResource(const SString &r)
     if (*pHostEnd == 0)
     {
         host        = pStart;
-        resource    = "";
         return ;
     }
     else if (*pHostEnd == ':')
@@ -154,54 +189,123 @@ void SHttpRequest::SetResource(const SString &r)
 
     pStart = pHostEnd;
     while (*pHostEnd != 0 && *pHostEnd != '?') pHostEnd++;
-    resource = URLUtils::Unescape(SString(pStart, pHostEnd - pStart));
+    pathStart       = pStart - pBase;
+    pathLength      = pHostEnd - pStart;
+    resourceDecoded = false;
 
     if (*pHostEnd == '?')
+        queryStart  = pHostEnd + 1 - pBase;
+}
+
+//! Hashes a query param name (FNV-1a)
+static inline unsigned QueryNameHash(const char *pName, size_t length)
+{
+    unsigned hash = 2166136261U;
+    for (size_t i = 0;i < length;i++)
+        hash = (hash ^ (unsigned char)pName[i]) * 16777619U;
+    return hash;
+}
+
+//! Splits the query string into name/value offsets and indexes the names.
+// Values are left escaped till they are looked up.
+void SHttpRequest::IndexQuery() const
+{
+    queryParams.clear();
+    queryIndex.clear();
+    queryIndexed = true;
+    if (queryStart == SString::npos)
+        return ;
+
+    const char *pBase   = realResource.c_str();
+    const char *pEnd    = pBase + realResource.size();
+    const char *pStart  = pBase + queryStart;
+    while (pStart < pEnd)
     {
-        // we have a query
-        const char *pNextParam = pHostEnd;
-        pStart = pNextParam + 1;
+        const char *pNext = (const char *)memchr(pStart, '&', pEnd - pStart);
+        if (pNext == NULL) pNext = pEnd;
+        const char *pEqPos      = (const char *)memchr(pStart, '=', pNext - pStart);
+        const char *pNameEnd    = pEqPos == NULL ? pNext : pEqPos;
 
-        do
+        if (pNameEnd > pStart)
         {
-            pNextParam = strchr(pStart, '&');
-            if (pNextParam == NULL) pNextParam = pEnd;
-            const char *pEqPos = strchr(pStart, '=');
-            if (pEqPos != NULL)
+            queryParams.push_back(SQueryParam());
+            SQueryParam &param  = queryParams.back();
+            param.nameStart     = pStart - pBase;
+            param.nameLength    = pNameEnd - pStart;
+            param.valueStart    = (pEqPos == NULL ? pNext : pEqPos + 1) - pBase;
+            param.valueLength   = pEqPos == NULL ? 0 : pNext - (pEqPos + 1);
+            param.escaped       = memchr(pStart, '%', param.nameLength) != NULL;
+            if (param.escaped)
             {
-                SString qName(pEqPos > pStart ? URLUtils::Unescape(SString(pStart, pEqPos - pStart)) : "");
-                SString qValue(pEqPos + 1 < pNextParam ? URLUtils::Unescape(SString(pEqPos + 1, pNextParam - (pEqPos + 1))) : "");
-                if (qName != "")
-                {
-                    queryValues.push_back(qName);
-                    queryValues.push_back(qValue);
-                }
+                URLUtils::Unescape(pStart, param.nameLength, param.unescapedName);
+                param.hash = QueryNameHash(param.unescapedName.data(), param.unescapedName.size());
             }
             else
             {
-                break ;
+                param.hash = QueryNameHash(pStart, param.nameLength);
             }
-            pStart = pNextParam + 1;
-        } while (pStart < pEnd);
+        }
+        pStart = pNext + 1;
+    }
+
+    // keep the index at most half full
+    size_t indexSize = 8;
+    while (indexSize < queryParams.size() * 2)
+        indexSize <<= 1;
+    queryIndex.assign(indexSize, -1);
+    for (size_t i = 0;i < queryParams.size();i++)
+    {
+        size_t slot = queryParams[i].hash & (indexSize - 1);
+        while (queryIndex[slot] >= 0)
+            slot = (slot + 1) & (indexSize - 1);
+        queryIndex[slot] = i;
     }
 }
 
-//! Get the value of a query param
-SString SHttpRequest::GetQueryValue(const SString &param) const
+//! Finds a query param by its (unescaped) name.  If a name is repeated
+// the first one wins.
+int SHttpRequest::FindQueryParam(const char *pName, size_t length) const
 {
-    for (SStringList::const_iterator iter = queryValues.begin(); iter != queryValues.end();++iter)
+    if (!queryIndexed)
+        IndexQuery();
+    if (queryParams.empty())
+        return -1;
+
+    unsigned    hash    = QueryNameHash(pName, length);
+    size_t      mask    = queryIndex.size() - 1;
+    for (size_t slot = hash & mask;queryIndex[slot] >= 0;slot = (slot + 1) & mask)
     {
-        if (*iter == param)
-        {
-            ++iter;
-            return *iter;
-        }
-        else
-        {
-            ++iter;
-        }
+        const SQueryParam &param = queryParams[queryIndex[slot]];
+        if (param.hash != hash)
+            continue ;
+
+        const char *pParamName  = param.escaped ? param.unescapedName.data() : realResource.data() + param.nameStart;
+        size_t      paramLength = param.escaped ? param.unescapedName.size() : param.nameLength;
+        if (paramLength == length && memcmp(pParamName, pName, length) == 0)
+            return queryIndex[slot];
     }
-    return "";
+    return -1;
+}
+
+//! Get the value of a query param
+SString SHttpRequest::GetQueryValue(const SString &param) const
+{
+    SString value;
+    GetQueryValue(param, value);
+    return value;
+}
+
+//! Gets the value of a query param if it is present
+bool SHttpRequest::GetQueryValue(const SString &param, SString &value) const
+{
+    int index = FindQueryParam(param.data(), param.size());
+    if (index < 0)
+        return false;
+
+    const SQueryParam &queryParam = queryParams[index];
+    value.clear();
+    URLUtils::Unescape(realResource.data() + queryParam.valueStart, queryParam.valueLength, value);
+    return true;
 }
 
 //! Parses the first line
@@ -231,11 +335,23 @@ bool SHttpRequest::ParseFirstLine(const SString &line)
 
     SLogger::Get()->Log("\nDEBUG: ===============================\n");
     SLogger::Get()->Log("DEBUG: Request: %s %s %s\n",
-                         method.c_str(), resource.c_str(), version.c_str());
+                         method.c_str(), realResource.c_str(), version.c_str());
 
     return true;
 }
 
+//! Sets the method, resource and version from an already parsed line
+void SHttpRequest::SetRequestLine(const SStringRef &m, const SStringRef &r, const SStringRef &v)
+{
+    method.assign(m.Data(), m.Size());
+    SetResource(r.Str());
+    version.assign(v.Data(), v.Size());
+
+    SLogger::Get()->Log("\nDEBUG: ===============================\n");
+    SLogger::Get()->Log("DEBUG: Request: %s %s %s\n",
+                         method.c_str(), realResource.c_str(), version.c_str());
+}
+
 // Reads the request line
 bool SHttpRequest::ReadFirstLine(std::istream &input)
 {
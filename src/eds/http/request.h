@@ -33,6 +33,8 @@
 #include <iostream>
 
 #include "message.h"
+#include "utils/strref.h"
+#include "thread/mutex.h"
 
 //*****************************************************************************
 /*!
@@ -75,6 +77,9 @@ public:
     //! Get the value of a query param
     SString GetQueryValue(const SString &param) const;
 
+    //! Gets the value of a query param if it is present
+    bool GetQueryValue(const SString &param, SString &value) const;
+
     //! Sets the request Resource
     void SetResource(const SString &resource);
 
@@ -82,7 +87,12 @@ public:
     int StatusCode() const;
 
     //! Sets the content body
-    void SetContentBody(SBodyPart *pPart) { pContentBody = pPart; }
+    void SetContentBody(SBodyPart *pPart)
+    {
+        if (pContentBody != NULL && pContentBody != pPart)
+            delete pContentBody;
+        pContentBody = pPart;
+    }
 
     //! Return the response for the request
     virtual SHttpResponse *Response() const { return pResponse; }
@@ -93,6 +103,45 @@ public:
     //! Gets the content body
     SBodyPart *ContentBody() const { return pContentBody; }
 
+    //! Gets the trailers sent after a chunked body - these are kept apart
+    // from the headers so a client cannot use them to add or override
+    // headers once the request has been checked
+    SHeaderTable &Trailers() { return trailers; }
+
+    //! Tells if the body is streamed to a module as it arrives instead
+    // of being available through ContentBody
+    bool BodyStreamed() const { return bodyStreamed; }
+
+    //! Sets whether the body is streamed to a module
+    void SetBodyStreamed(bool yes) { bodyStreamed = yes; }
+
+    //! Tells if the body was declined by a module before the client sent
+    // it (see SHttpModule::AcceptRequestBody)
+    bool BodyDeclined() const { return bodyDeclined; }
+
+    //! Sets whether the body was declined
+    void SetBodyDeclined(bool yes) { bodyDeclined = yes; }
+
+    //! Called by the reader once a streamed body has been read and by the
+    // writer once the response has been written.  Returns true for
+    // whichever of the two finishes last.
+    bool FinishStreamedRequest();
+
+    //! Gets the request pipelined after this one on the connection (if
+    // it has already been read)
+    SHttpRequest *NextRequest() const { return pNextRequest; }
+
+    //! Gets the request pipelined before this one on the connection
+    SHttpRequest *PrevRequest() const { return pPrevRequest; }
+
+    //! Sets the request pipelined after this one
+    void SetNextRequest(SHttpRequest *pNext)
+    {
+        pNextRequest = pNext;
+        if (pNext != NULL)
+            pNext->pPrevRequest = this;
+    }
+
     //! The status message
     const SString StatusMessage() const;
 
@@ -102,10 +151,39 @@ public:
     //! Parse the first line
     bool ParseFirstLine(const SString &line);
 
+    //! Sets the method, resource and version from an already parsed line
+    void SetRequestLine(const SStringRef &method, const SStringRef &resource, const SStringRef &version);
+
 protected:
     //! Reads the first request line
     virtual bool ReadFirstLine(std::istream &input);
 
+    //! Splits the query string and builds the name index
+    void IndexQuery() const;
+
+    //! Finds a query param by its (unescaped) name
+    int FindQueryParam(const char *pName, size_t length) const;
+
+protected:
+    //! A name=value pair in the query string - names and values are
+    // offsets into realResource and only unescaped when needed
+    struct SQueryParam
+    {
+        size_t      nameStart;
+        size_t      nameLength;
+        size_t      valueStart;
+        size_t      valueLength;
+
+        //! Hash of the unescaped name
+        unsigned    hash;
+
+        //! The unescaped name if the name had escapes in it
+        SString     unescapedName;
+
+        //! Whether unescapedName is used
+        bool        escaped;
+    };
+
 protected:
     //! The scheme (eg http, https etc)
     SString         scheme;
@@ -122,15 +200,53 @@ protected:
     //! The real resource with query vals and all
     SString         realResource;
 
-    //! Resource being accessed with the query vals stripped out
-    SString         resource;
+    //! Where the path is in realResource
+    size_t          pathStart;
+    size_t          pathLength;
+
+    //! Where the query string is in realResource (npos if none)
+    size_t          queryStart;
+
+    //! Resource being accessed with the query vals stripped out - only
+    // unescaped when first asked for
+    mutable SString resource;
+
+    //! Whether resource has been unescaped
+    mutable bool    resourceDecoded;
+
+    //! The GET values - only split up when first looked up
+    mutable std::vector<SQueryParam>    queryParams;
+
+    //! Open addressed hash index into queryParams (-1 for empty slots)
+    mutable std::vector<int>            queryIndex;
 
-    //! The GET values
-    SStringList     queryValues;
+    //! Whether queryParams and queryIndex have been built
+    mutable bool    queryIndexed;
 
     //! The actually data that is sent as the content - Usually POSTs
     SBodyPart *     pContentBody;
 
+    //! Trailers of a chunked body
+    SHeaderTable    trailers;
+
+    //! Whether the body is being streamed
+    bool            bodyStreamed;
+
+    //! Whether the body was declined
+    bool            bodyDeclined;
+
+    //! How many of the reader and writer are done with a streamed request
+    int             streamFinishCount;
+
+    //! Guards streamFinishCount
+    SMutex          streamMutex;
+
+    //! The request pipelined after this one
+    SHttpRequest *  pNextRequest;
+
+    //! The request pipelined before this one
+    SHttpRequest *  pPrevRequest;
+
     //! The connection that created this request
     SConnection *   pConnection;
 
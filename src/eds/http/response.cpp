@@ -29,8 +29,11 @@
 #include "response.h"
 #include "json/json.h"
 
+#include "thread/mutex.h"
+
 #include <sstream>
 #include <iterator>
+#include <time.h>
 
 // Creates a new http request object
 SHttpResponse::SHttpResponse()
@@ -48,6 +51,8 @@ SHttpResponse::~SHttpResponse()
 void SHttpResponse::Reset()
 {
     SHttpMessage::Reset();
+    statusCode      = 200;
+    statusMessage   = "OK";
 }
 
 // Sets the request status
@@ -80,6 +85,144 @@ int SHttpResponse::WriteHeaderLineToStream(std::ostream &output)
     return 0;
 }
 
+//! A pre-formatted HTTP/1.1 status line for a common status
+struct SStatusLine
+{
+    int         code;
+    const char *message;
+    const char *line;
+};
+
+static const SStatusLine COMMON_STATUS_LINES[] =
+{
+    { 100, "Continue",              "HTTP/1.1 100 Continue\r\n" },
+    { 200, "OK",                    "HTTP/1.1 200 OK\r\n" },
+    { 204, "No Content",            "HTTP/1.1 204 No Content\r\n" },
+    { 206, "Partial Content",       "HTTP/1.1 206 Partial Content\r\n" },
+    { 301, "Moved Permanently",     "HTTP/1.1 301 Moved Permanently\r\n" },
+    { 302, "Found",                 "HTTP/1.1 302 Found\r\n" },
+    { 304, "Not Modified",          "HTTP/1.1 304 Not Modified\r\n" },
+    { 400, "Bad Request",           "HTTP/1.1 400 Bad Request\r\n" },
+    { 403, "Forbidden",             "HTTP/1.1 403 Forbidden\r\n" },
+    { 404, "Not Found",             "HTTP/1.1 404 Not Found\r\n" },
+    { 413, "Request Entity Too Large", "HTTP/1.1 413 Request Entity Too Large\r\n" },
+    { 416, "Requested Range Not Satisfiable", "HTTP/1.1 416 Requested Range Not Satisfiable\r\n" },
+    { 500, "Internal Server Error", "HTTP/1.1 500 Internal Server Error\r\n" },
+    { 503, "Service Unavailable",   "HTTP/1.1 503 Service Unavailable\r\n" },
+};
+
+//*****************************************************************************
+/*!
+ *  \brief  Gets the current time formatted for a Date header.
+ *
+ *  The string only changes once a second so it is formatted once per
+ *  second and shared by all responses sent in that second.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+SString SHttpResponse::CurrentHttpDate()
+{
+    static SMutex   dateMutex;
+    static time_t   lastFormatted = 0;
+    static char     dateBuffer[64];
+
+    time_t now = time(NULL);
+    SMutexLock locker(dateMutex);
+    if (now != lastFormatted)
+    {
+        struct tm gmt;
+        gmtime_r(&now, &gmt);
+        strftime(dateBuffer, sizeof(dateBuffer), "%a, %d %b %Y %H:%M:%S GMT", &gmt);
+        lastFormatted = now;
+    }
+    return dateBuffer;
+}
+
+//! Formats a time as a HTTP date (eg for Last-Modified)
+SString SHttpResponse::FormatHttpDate(time_t when)
+{
+    char        dateBuffer[64];
+    struct tm   gmt;
+    gmtime_r(&when, &gmt);
+    strftime(dateBuffer, sizeof(dateBuffer), "%a, %d %b %Y %H:%M:%S GMT", &gmt);
+    return dateBuffer;
+}
+
+//! Parses a HTTP date - "Sun, 06 Nov 1994 08:49:37 GMT" or the obsolete
+// "Sunday, 06-Nov-94 08:49:37 GMT" and "Sun Nov  6 08:49:37 1994"
+time_t SHttpResponse::ParseHttpDate(const SString &date)
+{
+    static const char *DATE_FORMATS[] =
+    {
+        "%a, %d %b %Y %H:%M:%S GMT",
+        "%A, %d-%b-%y %H:%M:%S GMT",
+        "%a %b %e %H:%M:%S %Y"
+    };
+
+    for (size_t i = 0;i < sizeof(DATE_FORMATS) / sizeof(DATE_FORMATS[0]);i++)
+    {
+        struct tm   gmt;
+        memset(&gmt, 0, sizeof(gmt));
+        const char *pEnd = strptime(date.c_str(), DATE_FORMATS[i], &gmt);
+        if (pEnd != NULL && *pEnd == 0)
+            return timegm(&gmt);
+    }
+    return -1;
+}
+
+//*****************************************************************************
+/*!
+ *  \brief  Appends the status line and the headers to a buffer.
+ *
+ *  Unlike WriteToStream nothing is formatted via streams and nothing is
+ *  logged - this is what goes on the wire for every response.  Common
+ *  status lines are copied from a table and known header names from
+ *  pre-formatted prefixes.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+void SHttpResponse::AppendHeadTo(SString &output)
+{
+    const char *pStatusLine = NULL;
+    if (version == "HTTP/1.1")
+    {
+        size_t numLines = sizeof(COMMON_STATUS_LINES) / sizeof(COMMON_STATUS_LINES[0]);
+        for (size_t i = 0;i < numLines && pStatusLine == NULL;i++)
+        {
+            if (COMMON_STATUS_LINES[i].code == statusCode &&
+                statusMessage == COMMON_STATUS_LINES[i].message)
+            {
+                pStatusLine = COMMON_STATUS_LINES[i].line;
+            }
+        }
+    }
+
+    if (pStatusLine != NULL)
+    {
+        output += pStatusLine;
+    }
+    else
+    {
+        char codeBuffer[16];
+        snprintf(codeBuffer, sizeof(codeBuffer), " %d ", statusCode);
+        output += version;
+        output += codeBuffer;
+        output += statusMessage;
+        output += URLUtils::CRLF;
+    }
+
+    if (!headers.HasHeader(HDR_DATE))
+        headers.SetHeader(HDR_DATE, CurrentHttpDate());
+
+    headers.AppendTo(output);
+}
+
 //! Writes the response to a stream
 int SHttpResponse::WriteHeaderLineToFD(int fd)
 {
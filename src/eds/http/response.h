@@ -72,6 +72,20 @@ public:
     //! Write the first header line to a file descriptor
     virtual int WriteHeaderLineToFD(int fd);
 
+    //! Appends the status line and headers to a buffer (adding a Date
+    // header if there is none)
+    void AppendHeadTo(SString &output);
+
+    //! Gets the current time formatted for a Date header
+    static SString CurrentHttpDate();
+
+    //! Formats a time as a HTTP date (eg for Last-Modified)
+    static SString FormatHttpDate(time_t when);
+
+    //! Parses a HTTP date in any of the three allowed formats (-1 if it
+    // cannot be parsed)
+    static time_t ParseHttpDate(const SString &date);
+
 protected:
     //! Reads the first status line
     // virtual bool ReadFirstLine(std::istream &input);
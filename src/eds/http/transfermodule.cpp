@@ -26,19 +26,21 @@
 
 #include "transfermodule.h"
 #include "eds/connection.h"
+#include "eds/bodypart.h"
+#include "utils/urlutils.h"
 #include "handlerstage.h"
 #include "request.h"
 #include "response.h"
 
-//! This affects transfer-xxx headers but not content headers
+//! Frames the body parts as chunks if the response asks for it.
 //
-// Also this only takes place if 
+// This affects transfer-xxx headers but not content headers
 void STransferModule::ProcessOutput(SConnection *       pConnection,
                                     SHttpHandlerData *  pHandlerData,
                                     SHttpHandlerStage * pStage,
                                     SBodyPart *         pBodyPart)
 {
-    SHttpModuleData *pModData   = pHandlerData->GetModuleData(this, true);
+    STransferModuleData *pModData = dynamic_cast<STransferModuleData *>(pHandlerData->GetModuleData(this, true));
 
     // already being processed quit
     // TODO: not yet thread safe
@@ -69,40 +71,147 @@ void STransferModule::ProcessOutput(SConnection *       pConnection,
     pModData->SetProcessing(false);
 }
 
+//*****************************************************************************
+/*!
+ *  \brief  Decides (once per response) whether body parts are chunked.
+ *
+ *  Only HTTP/1.1 clients understand chunks.  For older ones the
+ *  Transfer-Encoding header is dropped and the end of the body is marked
+ *  by closing the connection instead.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created.
+ *
+ *****************************************************************************/
+void STransferModule::DecideFraming(SHttpRequest *pRequest, STransferModuleData *pModData)
+{
+    SHeaderTable &  respHeaders = pRequest->Response()->Headers();
+    const SString * pEncoding   = respHeaders.HeaderValue(HDR_TRANSFER_ENCODING);
+
+    pModData->framingDecided    = true;
+    pModData->chunked           = false;
+    if (pEncoding == NULL || strcasecmp(pEncoding->c_str(), "chunked") != 0)
+        return ;
 
-void STransferModule::HandleBodyPart(SConnection *      pConnection,
-                                     SHttpHandlerData *   pHandlerData,
-                                     SHttpHandlerStage *  pStage,
-                                     SHttpModuleData *    pModData,
-                                     SBodyPart *          pBodyPart)
+    if (pRequest->Version() == "HTTP/1.0")
+    {
+        respHeaders.RemoveHeader(HDR_TRANSFER_ENCODING);
+        pRequest->Headers().SetHeader(HDR_CONNECTION, "close");
+    }
+    else
+    {
+        respHeaders.RemoveHeader(HDR_CONTENT_LENGTH);
+        pModData->chunked = true;
+    }
+}
+
+//! Gets the number of bytes of data in a body part (-1 if not known)
+long long STransferModule::DataSize(SBodyPart *pBodyPart)
 {
-    SHttpRequest *pRequest      = pHandlerData->Request();
-    SHttpResponse *pResponse    = pRequest->Response();
-    SHeaderTable &respHeaders   = pResponse->Headers();
-    SString transferEncoding    = respHeaders.Header("Transfer-Encoding");
-
-    pBodyPart->bpIndex = pModData->nextBPToSend++;
-    if (pBodyPart->Type() == SHttpMessage::HTTP_BP_CLOSE_CONNECTION ||
-             pBodyPart->Type() == SHttpMessage::HTTP_BP_CONTENT_FINISHED)
+    switch (pBodyPart->Type())
+    {
+        case SBodyPart::BP_RAW:
+            return dynamic_cast<SRawBodyPart *>(pBodyPart)->Size();
+        case SBodyPart::BP_FILE:
+            return dynamic_cast<SFileBodyPart *>(pBodyPart)->Size();
+        case SBodyPart::BP_SPOOLED:
+            return dynamic_cast<SSpooledBodyPart *>(pBodyPart)->Size();
+        case SBodyPart::BP_SEGMENTED:
+            return dynamic_cast<SSegmentedBodyPart *>(pBodyPart)->Size();
+        case SBodyPart::BP_LAZY:
+            return dynamic_cast<SLazyBodyPart *>(pBodyPart)->Size();
+    }
+    return -1;
+}
+
+void STransferModule::HandleBodyPart(SConnection *          pConnection,
+                                     SHttpHandlerData *     pHandlerData,
+                                     SHttpHandlerStage *    pStage,
+                                     STransferModuleData *  pModData,
+                                     SBodyPart *            pBodyPart)
+{
+    SHttpRequest *  pRequest    = pHandlerData->Request();
+    SHttpResponse * pResponse   = pRequest->Response();
+    int             bpType      = pBodyPart->Type();
+
+    if (!pModData->framingDecided)
+        DecideFraming(pRequest, pModData);
+
+    // the connection is already being closed so the rest of the body is
+    // of no use
+    if (pModData->aborted)
+    {
+        delete pBodyPart;
+        return ;
+    }
+
+    if (!pModData->chunked || bpType == SHttpMessage::HTTP_BP_CLOSE_CONNECTION)
+    {
+        SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
+    }
+    else if (bpType == SHttpMessage::HTTP_BP_CONTENT_FINISHED)
     {
+        // the last chunk (with no trailers) goes before the finisher
+        SRawBodyPart *pLastChunk = pResponse->NewInsertedBodyPart();
+        pLastChunk->SetBody("0\r\n\r\n", 5);
+        SendBodyPartToModule(pConnection, pStage, pRequest, pLastChunk, pModData, pNextModule);
         SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
     }
     else
     {
-        assert("Transfer Module not yet implemented" && false);
-        /*
-        // write size first then the content
-        unsigned size = pBodyPart->Size();
-        if (strcasecmp(transferEncoding.c_str(), "chunked") == 0)
+        long long dataSize = DataSize(pBodyPart);
+        if (dataSize < 0 && bpType == SBodyPart::BP_LAZY)
         {
-            SStringStream sizestr;
-            sizestr << hex << size << URLUtils::CRLF;
-            pBodyPart->InsertInBody(sizestr.str(), 0);
-            pBodyPart->AppendToBody(URLUtils::CRLF, 2);
+            // the size is only known as the data is pulled so each pull
+            // goes out as a chunk of its own
+            dynamic_cast<SLazyBodyPart *>(pBodyPart)->SetChunked(true);
+            SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
+            return ;
         }
-        */
-    }
+        else if (dataSize < 0)
+        {
+            // the data cannot go out unframed in a chunked body, so cut
+            // the response short by closing the connection - the client
+            // sees the missing last chunk as an incomplete response
+            SLogger::Get()->Log("ERROR: Cannot chunk body part of type %d, closing connection\n", bpType);
+            delete pBodyPart;
+            pModData->aborted = true;
 
-    pStage->SendEvent_OutputToModule(pConnection, pNextModule, pBodyPart);
-}
+            SRawBodyPart *pCloser = pResponse->NewInsertedBodyPart();
+            pCloser->bpType = SHttpMessage::HTTP_BP_CLOSE_CONNECTION;
+            SendBodyPartToModule(pConnection, pStage, pRequest, pCloser, pModData, pNextModule);
+            return ;
+        }
 
+        // an empty chunk would end the body so empty parts are not framed
+        if (dataSize == 0)
+        {
+            SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
+            return ;
+        }
+
+        char sizeLine[24];
+        int lineLength = snprintf(sizeLine, sizeof(sizeLine), "%llx\r\n", dataSize);
+
+        if (bpType == SBodyPart::BP_SEGMENTED)
+        {
+            // segmented parts take their framing in place so each stays a
+            // whole chunk (that the writer may drop if the client lags)
+            SSegmentedBodyPart *pSegmentedPart = dynamic_cast<SSegmentedBodyPart *>(pBodyPart);
+            pSegmentedPart->Prepend(sizeLine, lineLength);
+            pSegmentedPart->Append(URLUtils::CRLF, 2);
+            SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
+            return ;
+        }
+
+        SRawBodyPart *pChunkHeader = pResponse->NewInsertedBodyPart();
+        pChunkHeader->SetBody(sizeLine, lineLength);
+        SRawBodyPart *pChunkTrailer = pResponse->NewInsertedBodyPart();
+        pChunkTrailer->SetBody(URLUtils::CRLF, 2);
+
+        SendBodyPartToModule(pConnection, pStage, pRequest, pChunkHeader, pModData, pNextModule);
+        SendBodyPartToModule(pConnection, pStage, pRequest, pBodyPart, pModData, pNextModule);
+        SendBodyPartToModule(pConnection, pStage, pRequest, pChunkTrailer, pModData, pNextModule);
+    }
+}
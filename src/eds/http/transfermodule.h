@@ -29,13 +29,46 @@
 
 #include "httpmodule.h"
 
-// Takes care of transfer encoding - Strips out Content-Length in chunked
-// mode
+// Per request state of the transfer module
+class STransferModuleData : public SHttpModuleData
+{
+public:
+    //! Constructor
+    STransferModuleData() : framingDecided(false), chunked(false), aborted(false) { }
+
+    //! Forgets what was decided for the last response
+    virtual void Reset()
+    {
+        SHttpModuleData::Reset();
+        framingDecided  = false;
+        chunked         = false;
+        aborted         = false;
+    }
+
+public:
+    //! Whether the framing was decided for the current response
+    bool    framingDecided;
+
+    //! Whether body parts are sent as chunks
+    bool    chunked;
+
+    //! Whether the response was cut short as a part could not be framed
+    bool    aborted;
+};
+
+// Takes care of transfer encoding.
+//
+// When a response has "Transfer-Encoding: chunked" every data part is sent
+// as a chunk so responses of unknown length can be streamed on persistent
+// connections.  The chunk size line and the CRLF after the data are sent
+// as small raw parts of their own around the (unmodified) data part - so
+// large raw parts are never copied (the writer gathers all three into one
+// write) and file parts still go out via sendfile.
 class STransferModule : public SHttpModule
 {
 public:
     //! Create it
-    STransferModule(SHttpModule *pNext) : SHttpModule(pNext) { }
+    STransferModule(SHttpModule *pNext = NULL) : SHttpModule(pNext) { }
 
     //! Called to handle output data from another module
     virtual void ProcessOutput(SConnection *        pConnection,
@@ -43,13 +76,24 @@ public:
                                SHttpHandlerStage *  pStage,
                                SBodyPart *          pBodyPart);
 
+    //! Creates new module data if necessary
+    virtual SHttpModuleData *CreateModuleData(SHttpHandlerData *pHandlerData)
+    {
+        return new STransferModuleData();
+    }
+
 protected:
-    void HandleBodyPart(SConnection *       pConnection,
-                        SHttpHandlerData *  pHandlerData, 
-                        SHttpHandlerStage * pStage,
-                        SHttpModuleData *   pModData,
-                        SBodyPart *         pBodyPart);
+    void HandleBodyPart(SConnection *           pConnection,
+                        SHttpHandlerData *      pHandlerData, 
+                        SHttpHandlerStage *     pStage,
+                        STransferModuleData *   pModData,
+                        SBodyPart *             pBodyPart);
+
+    //! Decides whether the response is to be chunked
+    void DecideFraming(SHttpRequest *pRequest, STransferModuleData *pModData);
+
+    //! Gets the number of bytes of data in a body part (-1 if not known)
+    static long long DataSize(SBodyPart *pBodyPart);
 };
 
 #endif
-
@@ -60,25 +60,42 @@ void SUrlRouter::ProcessInput(SConnection *         pConnection,
                               SHttpHandlerStage *   pStage,
                               SBodyPart *           pBodyPart)
 {
-    SHttpRequest *pRequest      = pHandlerData->Request();
+    SHttpModule *pModule = RouteRequest(pHandlerData->Request());
+    if (pModule != NULL)
+    {
+        pStage->SendEvent_InputToModule(pConnection, pModule);
+    }
+    else
+    {
+        // TODO: error or assert?
+    }
+}
+
+//! Asks the module the request will be routed to
+SHttpModule *SUrlRouter::RequestBodyModule(SHttpRequest *pRequest)
+{
+    SHttpModule *pModule = RouteRequest(pRequest);
+    return pModule == NULL ? NULL : pModule->RequestBodyModule(pRequest);
+}
+
+//! Asks the module the request will be routed to
+bool SUrlRouter::AcceptRequestBody(SHttpRequest *pRequest)
+{
+    SHttpModule *pModule = RouteRequest(pRequest);
+    return pModule == NULL || pModule->AcceptRequestBody(pRequest);
+}
+
+//! Gets the matching module or the default module if none match
+SHttpModule *SUrlRouter::RouteRequest(SHttpRequest *pRequest)
+{
     for (UrlMatcherList::const_iterator iter = urlMatchers.begin();
                 iter != urlMatchers.end();++iter)
     {
         if ((*iter)->Matches(pRequest->Resource()))
-        {
-            pStage->SendEvent_InputToModule(pConnection, (*iter)->Module());
-            return ;
-        }
+            return (*iter)->Module();
     }
 
     // see if there is a default module to send to
-    if (pNextModule != NULL)
-    {
-        pStage->SendEvent_InputToModule(pConnection, pNextModule);
-    }
-    else
-    {
-        // TODO: error or assert?
-    }
+    return pNextModule;
 }
 
@@ -136,6 +136,16 @@ public:
                               SHttpHandlerData *    pHandlerData,
                               SHttpHandlerStage *   pStage,
                               SBodyPart *           pBodyPart);
+
+    //! Asks the module the request will be routed to
+    virtual SHttpModule *RequestBodyModule(SHttpRequest *pRequest);
+
+    //! Asks the module the request will be routed to
+    virtual bool AcceptRequestBody(SHttpRequest *pRequest);
+
+protected:
+    //! Gets the module a request is to be routed to
+    virtual SHttpModule *RouteRequest(SHttpRequest *pRequest);
 };
 
 #endif
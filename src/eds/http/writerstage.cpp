@@ -35,6 +35,11 @@
 #include "request.h"
 #include "response.h"
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <time.h>
+#include <deque>
+
 //! Maintains request specific module data.
 class SHttpWriterState : public SHttpModuleData
 {
@@ -50,11 +55,33 @@ public:
 
 public:
     //! Creates a module data object.
-    SHttpWriterState() :
+    SHttpWriterState(SHttpWriterStage *pWriterStage) :
+        pStage(pWriterStage),
         currState(STATE_IDLE),
         bytesWritten(0),
         pCurrBodyPart(NULL),
-        pCurrRequest(NULL) { }
+        pCurrRequest(NULL),
+        pExpectedRequest(NULL),
+        interimWritten(0),
+        gatherOffset(0),
+        numWrites(0),
+        queuedBytes(0),
+        congested(false),
+        socketConfigured(false),
+        turnBytes(0),
+        lastSequence(-1),
+        zeroCopyPart(false),
+        zeroCopyDone(0),
+        zeroCopyOff(false) { }
+
+    //! Destroys the state along with any parts that were never written
+    virtual ~SHttpWriterState()
+    {
+        ClearPipelinedParts();
+        ClearGathered();
+        for (ZeroCopyPartList::iterator iter = zeroCopyPending.begin();iter != zeroCopyPending.end();++iter)
+            delete iter->first;
+    }
 
     virtual void Reset()
     {
@@ -65,6 +92,58 @@ public:
         currPayload         = "";
         pCurrBodyPart       = NULL;
         pCurrRequest        = NULL;
+        pExpectedRequest    = NULL;
+        numWrites           = 0;
+        interim.clear();
+        interimWritten      = 0;
+        ClearPipelinedParts();
+        ClearGathered();
+    }
+
+    //! Deletes parts gathered for writing
+    void ClearGathered()
+    {
+        for (SBodyPartList::iterator iter = gathered.begin();iter != gathered.end();++iter)
+            delete *iter;
+        gathered.clear();
+        gatherOffset = 0;
+    }
+
+    //! Tells if parts of a request can be written now or if they have to
+    // wait for the responses to requests pipelined before it
+    bool IsActiveRequest(SHttpRequest *pRequest)
+    {
+        if (pCurrRequest != NULL)
+            return pRequest == pCurrRequest;
+        else if (pExpectedRequest != NULL)
+            return pRequest == pExpectedRequest;
+        return pRequest->PrevRequest() == NULL;
+    }
+
+    //! Moves the held back parts of a request into the write queue
+    void ReleasePipelinedParts(SHttpRequest *pRequest)
+    {
+        SBodyPartList::iterator iter = pipelinedParts.begin();
+        while (iter != pipelinedParts.end())
+        {
+            if ((*iter)->ExtraData<SHttpRequest *>() == pRequest)
+            {
+                PutBodyPart(*iter);
+                iter = pipelinedParts.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+    //! Deletes held back parts
+    void ClearPipelinedParts()
+    {
+        for (SBodyPartList::iterator iter = pipelinedParts.begin();iter != pipelinedParts.end();++iter)
+            delete *iter;
+        pipelinedParts.clear();
     }
 
     //! Adds a new request to the queue.
@@ -79,7 +158,45 @@ public:
     //! Resumes writing of data
     void ResumeWriting(SConnection *pConnection, SBodyPart *pBodyPart);
 
+    //! Writes the headers and ready raw parts together
+    bool WriteGathered(SConnection *pConnection);
+
+    //! Writes out queued interim responses
+    bool WriteInterim(SConnection *pConnection);
+
+    //! Counts a new part as queued and deals with the client if it is
+    // falling behind.  Returns false if the connection was closed.
+    bool PartQueued(SConnection *pConnection, SBodyPart *pBodyPart);
+
+    //! Stops counting a part that has been written and destroys it
+    void PartWritten(SConnection *pConnection, SBodyPart *pBodyPart);
+
+    //! Drops queued messages as the slow consumer policy says
+    void ShedMessages(SBodyPart *pNewPart);
+
+    //! Starts a connection's turn at writing
+    void StartTurn();
+
+    //! Tells if the connection has used up its turn
+    bool TurnOver();
+
+    //! Tells if a part is sent with MSG_ZEROCOPY
+    bool SendsZeroCopy(SConnection *pConnection, SBodyPart *pBodyPart);
+
+    //! Tells if a part is written by WriteGathered
+    bool Gathers(SConnection *pConnection, SBodyPart *pBodyPart);
+
+    //! Destroys the zero copy parts the kernel is done with
+    void ReapZeroCopy(SConnection *pConnection);
+
 public:
+    //! Parts sent with MSG_ZEROCOPY along with the number of their last send
+    typedef std::deque<std::pair<SBodyPart *, unsigned> > ZeroCopyPartList;
+
+
+    //! The stage the state belongs to
+    SHttpWriterStage *  pStage;
+
     //! Current writer state
     int     currState;
 
@@ -95,17 +212,182 @@ public:
 
     //! Current requests being processed
     SHttpRequest *  pCurrRequest;
+
+    //! The pipelined request whose response is to be written next
+    SHttpRequest *  pExpectedRequest;
+
+    //! Parts of pipelined responses waiting for the ones before them
+    SBodyPartList   pipelinedParts;
+
+    //! Interim (1xx) responses to go out before the next response and how
+    // much of them has been written
+    SString         interim;
+    size_t          interimWritten;
+
+    //! Raw parts taken off the queue to be written in one go
+    SBodyPartList   gathered;
+
+    //! Bytes of the first gathered part already written
+    size_t          gatherOffset;
+
+    //! Write calls made for the current response
+    size_t          numWrites;
+
+    //! Bytes held by the parts queued for the connection
+    volatile size_t queuedBytes;
+
+    //! Whether the queued bytes went past the high water mark and have
+    // not yet drained below the low water mark
+    volatile bool   congested;
+
+    //! Whether the socket options have been applied
+    bool            socketConfigured;
+
+    //! Bytes written and when writing started in the current turn
+    size_t          turnBytes;
+    struct timespec turnStart;
+
+    //! Number of the last zero copy send of the current part (-1 if none)
+    long long       lastSequence;
+
+    //! Whether the current part started out being sent with zero copy (and
+    // so is written on its own till it is done)
+    bool            zeroCopyPart;
+
+    //! Parts sent with MSG_ZEROCOPY that the kernel may still be reading
+    ZeroCopyPartList    zeroCopyPending;
+
+    //! Number of the first zero copy send not known to be complete
+    unsigned        zeroCopyDone;
+
+    //! Whether zero copy was given up on as the kernel kept copying
+    bool            zeroCopyOff;
 };
 
+//! Most raw parts written in one go
+static const int MAX_GATHERED_PARTS = 16;
+
+//! Most buffers handed to one gathered write
+static const int MAX_GATHERED_IOVECS = 64;
+
+//! Tells if a part is written by WriteGathered
+static inline bool IsGatherable(SBodyPart *pBodyPart)
+{
+    return pBodyPart->Type() == SBodyPart::BP_RAW || pBodyPart->Type() == SBodyPart::BP_SEGMENTED;
+}
+
+//! Size of a part written by WriteGathered
+static inline size_t GatheredSize(SBodyPart *pBodyPart)
+{
+    if (pBodyPart->Type() == SBodyPart::BP_SEGMENTED)
+        return ((SSegmentedBodyPart *)pBodyPart)->Size();
+    return ((SRawBodyPart *)pBodyPart)->Size();
+}
+
+//! Bytes of memory held by a queued part
+static inline size_t QueuedSize(SBodyPart *pBodyPart)
+{
+    switch (pBodyPart->Type())
+    {
+        case SBodyPart::BP_RAW:
+        case SBodyPart::BP_SEGMENTED:
+            return GatheredSize(pBodyPart);
+        case SBodyPart::BP_SPOOLED:
+        {
+            SSpooledBodyPart *pSpooledPart = (SSpooledBodyPart *)pBodyPart;
+            return pSpooledPart->IsSpooled() ? 0 : pSpooledPart->Size();
+        }
+    }
+    return 0;
+}
+
+//! Orders parts by when they are written
+static bool WrittenBefore(SBodyPart *a, SBodyPart *b)
+{
+    return a->Index() < b->Index();
+}
+
 // Creates a new file io helper stage
-SHttpWriterStage::SHttpWriterStage(const SString &name, int numThreads) : SWriterStage(name, numThreads)
+SHttpWriterStage::SHttpWriterStage(const SString &name, int numThreads)
+:
+    SWriterStage(name, numThreads),
+    highWaterMark(DEFAULT_HIGH_WATER_MARK),
+    lowWaterMark(DEFAULT_LOW_WATER_MARK),
+    slowConsumerPolicy(SLOW_CONSUMER_BLOCK),
+    writeBudgetBytes(DEFAULT_WRITE_BUDGET_BYTES),
+    writeBudgetMsecs(DEFAULT_WRITE_BUDGET_MSECS),
+    zeroCopyThreshold(0),
+    notSentLowWater(0)
 {
+    memset(&zeroCopyStats, 0, sizeof(zeroCopyStats));
+    memset(&writeStats, 0, sizeof(writeStats));
 }
 
 //! Creates a new reader state object
 void *SHttpWriterStage::CreateStageData()
 {
-    return new SHttpWriterState();
+    return new SHttpWriterState(this);
+}
+
+//! Tells if the output queued for a connection is past the high water mark
+bool SHttpWriterStage::IsCongested(SConnection *pConnection)
+{
+    SHttpWriterState *pWriterState = (SHttpWriterState *)pConnection->GetStageData(this);
+    return pWriterState != NULL && pWriterState->congested;
+}
+
+//! Bytes queued for a connection
+size_t SHttpWriterStage::QueuedBytes(SConnection *pConnection)
+{
+    SHttpWriterState *pWriterState = (SHttpWriterState *)pConnection->GetStageData(this);
+    return pWriterState == NULL ? 0 : pWriterState->queuedBytes;
+}
+
+//! Tells the listeners a connection has become congested
+void SHttpWriterStage::NotifyCongested(SConnection *pConnection)
+{
+    for (std::list<SOutboundListener *>::iterator iter = listeners.begin();iter != listeners.end();++iter)
+        (*iter)->OutboundCongested(pConnection);
+}
+
+//! Tells the listeners a connection has drained
+void SHttpWriterStage::NotifyDrained(SConnection *pConnection)
+{
+    for (std::list<SOutboundListener *>::iterator iter = listeners.begin();iter != listeners.end();++iter)
+        (*iter)->OutboundDrained(pConnection);
+}
+
+//! Adds to the zero copy counts
+void SHttpWriterStage::CountZeroCopy(size_t numSends, size_t numCompleted, size_t numCopied, size_t numFallbacks)
+{
+    __sync_add_and_fetch(&zeroCopyStats.numSends, numSends);
+    __sync_add_and_fetch(&zeroCopyStats.numCompleted, numCompleted);
+    __sync_add_and_fetch(&zeroCopyStats.numCopied, numCopied);
+    __sync_add_and_fetch(&zeroCopyStats.numFallbacks, numFallbacks);
+}
+
+//! Adds to the write call counts
+void SHttpWriterStage::CountWrites(size_t numResponses, size_t numWrites)
+{
+    __sync_add_and_fetch(&writeStats.numResponses, numResponses);
+    __sync_add_and_fetch(&writeStats.numWrites, numWrites);
+}
+
+//! Applies TCP_NOTSENT_LOWAT and SO_ZEROCOPY to a new connection
+void SHttpWriterStage::ConfigureSocket(SConnection *pConnection)
+{
+    if (zeroCopyThreshold > 0)
+        pConnection->EnableZeroCopy();
+
+#ifdef TCP_NOTSENT_LOWAT
+    if (notSentLowWater > 0 &&
+        setsockopt(pConnection->Socket(), IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                   &notSentLowWater, sizeof(notSentLowWater)) != 0)
+    {
+        SLogger::Get()->Log("ERROR: Could not set TCP_NOTSENT_LOWAT, Error [%d]: %s\n",
+                            errno, strerror(errno));
+    }
+#endif
 }
 
 //! Destroys reader state objects
@@ -121,6 +403,12 @@ bool SHttpWriterStage::SendEvent_WriteBodyPart(SConnection *pConnection, SBodyPa
     return QueueEvent(SEvent(EVT_WRITE_BODY_PART, pConnection, pBodyPart));
 }
 
+//! Write a 100 Continue out
+bool SHttpWriterStage::SendEvent_WriteContinue(SConnection *pConnection)
+{
+    return QueueEvent(SEvent(EVT_WRITE_CONTINUE, pConnection));
+}
+
 //! Re orders and sends out http body parts to the socket
 void SHttpWriterStage::HandleEvent(const SEvent &event)
 {
@@ -128,28 +416,240 @@ void SHttpWriterStage::HandleEvent(const SEvent &event)
     SHttpWriterState *  pWriterState    = (SHttpWriterState *)pConnection->GetStageData(this);
     SBodyPart *         pBodyPart       = (SBodyPart *)(event.pData);
 
+    if (event.evType == EVT_WRITE_CONTINUE)
+    {
+        static const char CONTINUE_RESPONSE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        pWriterState->interim.append(CONTINUE_RESPONSE, sizeof(CONTINUE_RESPONSE) - 1);
+        pBodyPart = NULL;
+    }
+
+    if (!pWriterState->socketConfigured)
+    {
+        ConfigureSocket(pConnection);
+        pWriterState->socketConfigured = true;
+    }
     pWriterState->ResumeWriting(pConnection, pBodyPart);
 }
 
-void SHttpWriterState::ResumeWriting(SConnection *pConnection, SBodyPart *pBodyPart)
+//! Starts a connection's turn at writing
+void SHttpWriterState::StartTurn()
 {
-    int numWritten = 0;
+    turnBytes = 0;
+    if (pStage->WriteBudgetMsecs() > 0)
+        clock_gettime(CLOCK_MONOTONIC, &turnStart);
+}
+
+//! Tells if the connection has used up its turn
+bool SHttpWriterState::TurnOver()
+{
+    if (pStage->WriteBudgetBytes() > 0 && turnBytes >= pStage->WriteBudgetBytes())
+        return true;
+    else if (pStage->WriteBudgetMsecs() <= 0 || turnBytes == 0)
+        return false;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsed = (now.tv_sec - turnStart.tv_sec) * 1000 + (now.tv_nsec - turnStart.tv_nsec) / 1000000;
+    return elapsed >= pStage->WriteBudgetMsecs();
+}
+
+//! Tells if a part is sent with MSG_ZEROCOPY
+bool SHttpWriterState::SendsZeroCopy(SConnection *pConnection, SBodyPart *pBodyPart)
+{
+    size_t threshold = pStage->ZeroCopyThreshold();
+    return threshold > 0 && !zeroCopyOff && pConnection->ZeroCopyEnabled() &&
+           pBodyPart->Type() == SBodyPart::BP_RAW &&
+           (size_t)((SRawBodyPart *)pBodyPart)->Size() >= threshold;
+}
+
+//! Tells if a part is written by WriteGathered
+bool SHttpWriterState::Gathers(SConnection *pConnection, SBodyPart *pBodyPart)
+{
+    return IsGatherable(pBodyPart) && !SendsZeroCopy(pConnection, pBodyPart);
+}
+
+//! Reads the zero copy completions off the socket and destroys the parts
+// whose sends are all complete.  TCP completes sends in order so it is
+// enough to know the first send that is not yet complete.
+void SHttpWriterState::ReapZeroCopy(SConnection *pConnection)
+{
+    unsigned    first;
+    unsigned    last;
+    bool        copied;
+    size_t      numCompleted    = 0;
+    size_t      numCopied       = 0;
+    while (pConnection->NextZeroCopyCompletion(first, last, copied))
+    {
+        numCompleted   += last - first + 1;
+        zeroCopyDone    = last + 1;
+        if (copied)
+            numCopied  += last - first + 1;
+    }
+    if (numCompleted == 0)
+        return ;
+
+    pStage->CountZeroCopy(0, numCompleted, numCopied, 0);
+    if (numCopied > 0 && !zeroCopyOff)
+    {
+        // the pages were copied anyway (eg over loopback) so pinning them
+        // only costs more
+        SLogger::Get()->Log("DEBUG: Zero copy sends on connection [%x] were copied, "
+                            "copying from now on\n", pConnection);
+        zeroCopyOff = true;
+    }
 
+    while (!zeroCopyPending.empty() && (int)(zeroCopyPending.front().second - zeroCopyDone) < 0)
+    {
+        PartWritten(pConnection, zeroCopyPending.front().first);
+        zeroCopyPending.pop_front();
+    }
+}
+
+//! Counts a new part as queued and deals with the client if it is falling
+// behind.  Returns false if the connection was closed.
+bool SHttpWriterState::PartQueued(SConnection *pConnection, SBodyPart *pBodyPart)
+{
+    queuedBytes += QueuedSize(pBodyPart);
+    if (pConnection->GetState() == SConnection::STATE_CLOSED)
+        return false;
+    else if (queuedBytes <= pStage->HighWaterMark())
+        return true;
+
+    switch (pStage->GetSlowConsumerPolicy())
+    {
+        case SHttpWriterStage::SLOW_CONSUMER_DROP_OLDEST:
+        case SHttpWriterStage::SLOW_CONSUMER_CONFLATE:
+            ShedMessages(pBodyPart);
+            break ;
+        case SHttpWriterStage::SLOW_CONSUMER_DISCONNECT:
+            SLogger::Get()->Log("DEBUG: Closing slow connection [%x] with %zu bytes queued\n",
+                                pConnection, (size_t)queuedBytes);
+            pConnection->Server()->SetConnectionState(pConnection, SConnection::STATE_CLOSED);
+            return false;
+        default:
+            break ;
+    }
+
+    if (!congested && queuedBytes > pStage->HighWaterMark())
+    {
+        congested = true;
+        pStage->NotifyCongested(pConnection);
+    }
+    return true;
+}
+
+//! Stops counting a part that has been written and destroys it
+void SHttpWriterState::PartWritten(SConnection *pConnection, SBodyPart *pBodyPart)
+{
+    size_t partSize = QueuedSize(pBodyPart);
+    queuedBytes     = partSize < queuedBytes ? queuedBytes - partSize : 0;
+    delete pBodyPart;
+
+    if (congested && queuedBytes <= pStage->LowWaterMark())
+    {
+        congested = false;
+        pStage->NotifyDrained(pConnection);
+    }
+}
+
+//! Drops queued messages as the slow consumer policy says.  Only droppable
+// parts still waiting in the queue (ie none of whose bytes have been
+// written) are dropped and they are emptied rather than taken out so the
+// parts after them keep their place.
+void SHttpWriterState::ShedMessages(SBodyPart *pNewPart)
+{
+    SBodyPartVector &queued = bodyParts.Parts();
+    SBodyPartVector candidates;
+    for (SBodyPartVector::iterator iter = queued.begin();iter != queued.end();++iter)
+    {
+        if ((*iter)->Type() != SBodyPart::BP_SEGMENTED)
+            continue ;
+        SSegmentedBodyPart *pPart = (SSegmentedBodyPart *)(*iter);
+        if (pPart->IsDroppable() && pPart->Size() > 0)
+            candidates.push_back(pPart);
+    }
+    std::sort(candidates.begin(), candidates.end(), WrittenBefore);
+
+    int numDropped = 0;
+    if (pStage->GetSlowConsumerPolicy() == SHttpWriterStage::SLOW_CONSUMER_CONFLATE)
+    {
+        // older messages with the new message's key are out of date
+        if (pNewPart->Type() != SBodyPart::BP_SEGMENTED)
+            return ;
+        SSegmentedBodyPart *pNewMessage = (SSegmentedBodyPart *)pNewPart;
+        if (!pNewMessage->IsDroppable() || pNewMessage->ConflationKey().empty())
+            return ;
+
+        for (SBodyPartVector::iterator iter = candidates.begin();iter != candidates.end();++iter)
+        {
+            SSegmentedBodyPart *pPart = (SSegmentedBodyPart *)(*iter);
+            if (pPart != pNewMessage && pPart->Index() < pNewMessage->Index() &&
+                pPart->ConflationKey() == pNewMessage->ConflationKey())
+            {
+                queuedBytes -= pPart->Size();
+                pPart->Clear();
+                numDropped++;
+            }
+        }
+    }
+    else
+    {
+        for (SBodyPartVector::iterator iter = candidates.begin();
+                iter != candidates.end() && queuedBytes > pStage->HighWaterMark();++iter)
+        {
+            SSegmentedBodyPart *pPart = (SSegmentedBodyPart *)(*iter);
+            queuedBytes -= pPart->Size();
+            pPart->Clear();
+            numDropped++;
+        }
+    }
+
+    if (numDropped > 0)
+    {
+        SLogger::Get()->Log("DEBUG: Dropped %d messages for slow client, %zu bytes still queued\n",
+                            numDropped, (size_t)queuedBytes);
+    }
+}
+
+void SHttpWriterState::ResumeWriting(SConnection *pConnection, SBodyPart *pBodyPart)
+{
     if (pBodyPart != NULL)
     {
         // A new body needs to be sent out - 
         // if a body is being written then queue this...
-        PutBodyPart(pBodyPart);
+        // unless it is the response to a later pipelined request
+        if (IsActiveRequest(pBodyPart->ExtraData<SHttpRequest *>()))
+            PutBodyPart(pBodyPart);
+        else
+            pipelinedParts.push_back(pBodyPart);
+        if (!PartQueued(pConnection, pBodyPart))
+            return ;
         if (currState == STATE_IDLE)
         {
             assert("Why is current body not NULL??" && pCurrBodyPart == NULL);
         }
     }
 
+    if (!zeroCopyPending.empty())
+        ReapZeroCopy(pConnection);
+
+    // the connection gets a budget of bytes and time after which it has to
+    // give the writer up to other connections and wait for its next turn
+    StartTurn();
     while (true)
     {
+        if (TurnOver())
+        {
+            pConnection->Server()->ResumeWriteLater(pConnection);
+            return ;
+        }
+
         if (currState == SHttpWriterState::STATE_IDLE)
         {
+            // interim responses go out before the response is started
+            if (!WriteInterim(pConnection))
+                return ;
+
             if (pCurrBodyPart == NULL)
             {
                 pCurrBodyPart = NextBodyPart();
@@ -166,22 +666,29 @@ void SHttpWriterState::ResumeWriting(SConnection *pConnection, SBodyPart *pBodyP
                 // first body part in the chain
                 SHttpResponse * pResponse   = pCurrRequest->Response();
                 SHeaderTable &  respHeaders = pResponse->Headers();
-                stringstream    sstr;
 
                 // write headers
-                SString transferEncoding(respHeaders.Header("Transfer-Encoding"));
-                if (strcasecmp(transferEncoding.c_str(), "chunked") == 0)
+                // let the client know if the connection will be closed
+                if (pCurrRequest->Headers().CloseConnection())
                 {
-                    respHeaders.RemoveHeader("Content-Length");
+                    respHeaders.SetHeader(HDR_CONNECTION, "close");
                 }
 
-                pResponse->WriteHeaderLineToStream(sstr);
-                respHeaders.WriteToStream(sstr);
+                if (strcasecmp(respHeaders.Header(HDR_TRANSFER_ENCODING).c_str(), "chunked") == 0)
+                {
+                    respHeaders.RemoveHeader(HDR_CONTENT_LENGTH);
+                }
+
+                // serialize straight into the (reused) payload buffer
+                currPayload.clear();
+                pResponse->AppendHeadTo(currPayload);
                 respHeaders.Lock(); // no more changes allowed in response headers
 
+                SLogger::Get()->Log("DEBUG: Response: %d %s\n",
+                                    pResponse->StatusCode(), pResponse->StatusMessage().c_str());
+
                 currState       = STATE_WRITING_HEADERS;
                 bytesWritten    = 0;
-                currPayload     = sstr.str();
             }
             else
             {
@@ -191,22 +698,30 @@ void SHttpWriterState::ResumeWriting(SConnection *pConnection, SBodyPart *pBodyP
         }
         else if (currState == STATE_WRITING_HEADERS)
         {
-            int length      = currPayload.size() - bytesWritten;
-            if ((numWritten = pConnection->WriteData(currPayload.c_str() + bytesWritten, length)) < 0)
+            // the headers go out with whatever raw parts are ready
+            if (!WriteGathered(pConnection))
                 return ;
-            bytesWritten += numWritten;
-            if (numWritten == length)
-            {
-                // done go to the next stage
-                currState       = SHttpWriterState::STATE_WRITING_BODY;
-                bytesWritten    = 0;
-                currPayload     = "";
-            }
         }
         else if (currState == STATE_WRITING_BODY)
         {
             assert("Request Cannot be NULL" && pCurrRequest != NULL);
 
+            if (!gathered.empty() || pCurrBodyPart == NULL ||
+                (!zeroCopyPart && Gathers(pConnection, pCurrBodyPart)))
+            {
+                // raw and segmented parts are written together
+                if (!WriteGathered(pConnection))
+                    return ;
+                // a full batch may have gone out with more parts waiting
+                if (gathered.empty() && pCurrBodyPart == NULL &&
+                    (pCurrBodyPart = NextBodyPart()) == NULL)
+                {
+                    // no more body parts so just quit and come back later
+                    return ;
+                }
+                continue ;
+            }
+
             if (pCurrBodyPart == NULL)
             {
                 assert("On a new BP, bytesWritten MUST be 0" && bytesWritten == 0);
@@ -219,11 +734,8 @@ void SHttpWriterState::ResumeWriting(SConnection *pConnection, SBodyPart *pBodyP
                 assert("Current request must be same as body's request" && pCurrRequest == pCurrBodyPart->ExtraData<SHttpRequest *>());
             }
 
-            SHttpResponse * pResponse   = pCurrRequest->Response();
             SHeaderTable &  reqHeaders  = pCurrRequest->Headers();
-            SHeaderTable &  respHeaders = pResponse->Headers();
             int             bpType      = pCurrBodyPart->Type();
-            SString transferEncoding(respHeaders.Header("Transfer-Encoding"));
 
             if (bpType == SHttpMessage::HTTP_BP_CONTENT_FINISHED ||
                 bpType == SHttpMessage::HTTP_BP_CLOSE_CONNECTION)
@@ -232,6 +744,8 @@ void SHttpWriterState::ResumeWriting(SConnection *pConnection, SBodyPart *pBodyP
                 // be sent for this request
                 bool closeConnection    = reqHeaders.CloseConnection() ||
                                           bpType == SHttpMessage::HTTP_BP_CLOSE_CONNECTION;
+                SHttpRequest *pRequest  = pCurrRequest;
+                SHttpRequest *pNext     = pRequest->NextRequest();
                 bytesWritten            = 0;
                 nextBP                  = 0;
                 nextBPToSend            = 0;
@@ -240,10 +754,19 @@ void SHttpWriterState::ResumeWriting(SConnection *pConnection, SBodyPart *pBodyP
                 delete pCurrBodyPart;
                 pCurrBodyPart   = NULL;
 
-                // remove and destroy the request from the queue
-                // Note this destroys pRequest - 
-                // dont use pRequest or Request() after this
+                SLogger::Get()->Log("DEBUG: Body parts for request [%x]: "
+                                    "request %zu, response %zu, %zu writes\n", pRequest,
+                                    pRequest->NumPartsCreated(),
+                                    pRequest->Response()->NumPartsCreated(), numWrites);
+                pStage->CountWrites(1, numWrites);
+                numWrites = 0;
+
+                // done with this request - this only clears the writer's
+                // current request (so Request() is NULL after this).
+                // pRequest is owned (and reused) by the connection's reader
+                // state and stays alive, so it can still be used below.
                 DestroyRequest();
+                pExpectedRequest = pNext;
 
                 // do nothing - close connection only if close header found
                 if (closeConnection || pConnection->GetState() >= SConnection::STATE_PEER_CLOSED)
@@ -255,8 +778,20 @@ void SHttpWriterState::ResumeWriting(SConnection *pConnection, SBodyPart *pBodyP
                     // connection
                     pConnection->Server()->SetConnectionState(pConnection, SConnection::STATE_CLOSED);
                 }
+                else if (pRequest->BodyStreamed() && !pRequest->FinishStreamedRequest())
+                {
+                    // the body is still being read - the reader will
+                    // finish the connection once it is done
+                }
+                else if (pNext != NULL)
+                {
+                    // go on to the response for the next pipelined request
+                    ReleasePipelinedParts(pNext);
+                }
                 else
                 {
+                    pExpectedRequest = NULL;
+
                     // tell the reader we are ready for more
                     // should we? or should we let the server take care of this?
                     pConnection->Server()->SetConnectionState(pConnection, SConnection::STATE_FINISHED);
@@ -264,10 +799,27 @@ void SHttpWriterState::ResumeWriting(SConnection *pConnection, SBodyPart *pBodyP
             }
             else // treat as normal message
             {
-                int numWritten = 0;
-                bool bytesLeft  = pCurrBodyPart->WriteToConnection(pConnection, numWritten);
+                int     numWritten  = 0;
+                bool    bytesLeft;
+                numWrites++;
+                if (SendsZeroCopy(pConnection, pCurrBodyPart))
+                {
+                    zeroCopyPart = true;
+                    long long sequence;
+                    bytesLeft = ((SRawBodyPart *)pCurrBodyPart)->WriteToConnectionZeroCopy(pConnection, numWritten, sequence);
+                    if (sequence >= 0)
+                    {
+                        lastSequence = sequence;
+                        pStage->CountZeroCopy(1, 0, 0, 0);
+                    }
+                }
+                else
+                {
+                    bytesLeft = pCurrBodyPart->WriteToConnection(pConnection, numWritten);
+                }
                 if (numWritten < 0)
                     return ;
+                turnBytes += numWritten;
 
                 bytesWritten += numWritten;
                 if (!bytesLeft)
@@ -276,8 +828,20 @@ void SHttpWriterState::ResumeWriting(SConnection *pConnection, SBodyPart *pBodyP
                     // but state remains the same
                     bytesWritten    = 0;
                     nextBPToSend++;
-                    delete pCurrBodyPart;
-                    pCurrBodyPart = NULL;
+                    if (lastSequence >= 0)
+                    {
+                        // the kernel may still be reading the part's data
+                        zeroCopyPending.push_back(std::make_pair(pCurrBodyPart, (unsigned)lastSequence));
+                        lastSequence = -1;
+                    }
+                    else
+                    {
+                        if (zeroCopyPart)
+                            pStage->CountZeroCopy(0, 0, 0, 1);
+                        PartWritten(pConnection, pCurrBodyPart);
+                    }
+                    zeroCopyPart    = false;
+                    pCurrBodyPart   = NULL;
                 }
             }
         }
@@ -288,3 +852,123 @@ void SHttpWriterState::ResumeWriting(SConnection *pConnection, SBodyPart *pBodyP
     }
 }
 
+//! Writes out queued interim responses.  Returns false if they could not
+// all be written yet (writing resumes when the socket is writable again).
+bool SHttpWriterState::WriteInterim(SConnection *pConnection)
+{
+    while (interimWritten < interim.size())
+    {
+        numWrites++;
+        int numWritten = pConnection->WriteData(interim.c_str() + interimWritten,
+                                                interim.size() - interimWritten);
+        if (numWritten < 0)
+            return false;
+        turnBytes      += numWritten;
+        interimWritten += numWritten;
+    }
+    interim.clear();
+    interimWritten = 0;
+    return true;
+}
+
+//! Writes the rest of the headers (if they are being written) along with
+// the raw and segmented body parts that are ready, in as few writes as
+// possible.  Parts are taken off the queue till one that is not in memory
+// is found, which is left in pCurrBodyPart.  Returns false if the
+// connection cannot take any more for now.
+bool SHttpWriterState::WriteGathered(SConnection *pConnection)
+{
+    while (gathered.size() < (size_t)MAX_GATHERED_PARTS)
+    {
+        if (pCurrBodyPart == NULL && (pCurrBodyPart = NextBodyPart()) == NULL)
+            break ;
+        if (!Gathers(pConnection, pCurrBodyPart))
+            break ;
+        if (pStage->ZeroCopyThreshold() > 0 && pCurrBodyPart->Type() == SBodyPart::BP_RAW &&
+            (size_t)((SRawBodyPart *)pCurrBodyPart)->Size() >= pStage->ZeroCopyThreshold())
+        {
+            // big enough but zero copy is not to be had on the connection
+            pStage->CountZeroCopy(0, 0, 0, 1);
+        }
+        assert("Current request must be same as body's request" && pCurrRequest == pCurrBodyPart->ExtraData<SHttpRequest *>());
+        gathered.push_back(pCurrBodyPart);
+        pCurrBodyPart = NULL;
+    }
+
+    struct iovec    iov[MAX_GATHERED_IOVECS + 1];
+    int             numIov      = 0;
+    size_t          offset      = gatherOffset;
+    if (currState == STATE_WRITING_HEADERS)
+    {
+        iov[numIov].iov_base    = const_cast<char *>(currPayload.c_str() + bytesWritten);
+        iov[numIov].iov_len     = currPayload.size() - bytesWritten;
+        numIov++;
+    }
+    for (SBodyPartList::iterator iter = gathered.begin();
+            iter != gathered.end() && numIov < MAX_GATHERED_IOVECS;++iter, offset = 0)
+    {
+        if ((*iter)->Type() == SBodyPart::BP_SEGMENTED)
+        {
+            SSegmentedBodyPart *pPart = (SSegmentedBodyPart *)(*iter);
+            numIov += pPart->FillIOVec(iov + numIov, MAX_GATHERED_IOVECS - numIov, offset);
+            continue ;
+        }
+
+        SRawBodyPart *pPart = (SRawBodyPart *)(*iter);
+        if ((size_t)pPart->Size() > offset)
+        {
+            iov[numIov].iov_base    = &(pPart->data[offset]);
+            iov[numIov].iov_len     = pPart->Size() - offset;
+            numIov++;
+        }
+    }
+
+    int numWritten = 0;
+    if (numIov > 0)
+    {
+        // let a file sent right after coalesce with what is written here
+        bool more = pCurrBodyPart != NULL &&
+                    (pCurrBodyPart->Type() == SBodyPart::BP_FILE ||
+                     pCurrBodyPart->Type() == SBodyPart::BP_SPOOLED);
+        numWrites++;
+        if ((numWritten = pConnection->WriteData(iov, numIov, more)) < 0)
+            return false;
+        turnBytes += numWritten;
+    }
+
+    // see how far we got
+    size_t numLeft = numWritten;
+    if (currState == STATE_WRITING_HEADERS)
+    {
+        size_t headerLeft = currPayload.size() - bytesWritten;
+        if (numLeft < headerLeft)
+        {
+            bytesWritten += numLeft;
+            return true;
+        }
+
+        // done go to the next stage
+        numLeft        -= headerLeft;
+        currState       = SHttpWriterState::STATE_WRITING_BODY;
+        bytesWritten    = 0;
+        currPayload.clear();
+    }
+
+    while (!gathered.empty())
+    {
+        SBodyPart *     pPart       = gathered.front();
+        size_t          partLeft    = GatheredSize(pPart) - gatherOffset;
+        if (numLeft < partLeft)
+        {
+            gatherOffset += numLeft;
+            break ;
+        }
+
+        numLeft        -= partLeft;
+        gatherOffset    = 0;
+        nextBPToSend++;
+        gathered.pop_front();
+        PartWritten(pConnection, pPart);
+    }
+    return true;
+}
@@ -35,6 +35,29 @@
 class SBodyPart;
 class SHttpWriterState;
 
+//*****************************************************************************
+/*!
+ *  \class  SOutboundListener
+ *
+ *  \brief  Told when the output queued for a connection goes past the high
+ *  water mark and when it drains below the low water mark again, so
+ *  producers can hold back in between.
+ *
+ *  Calls are made from the writer's threads.
+ *
+ *****************************************************************************/
+class SOutboundListener
+{
+public:
+    virtual ~SOutboundListener() { }
+
+    //! Called when the output queued for a connection gets too large
+    virtual void OutboundCongested(SConnection *pConnection) { }
+
+    //! Called when the queued output has drained
+    virtual void OutboundDrained(SConnection *pConnection) { }
+};
+
 // Takes care of transfer encoding - Strips out Content-Length in chunked
 // mode
 class SHttpWriterStage : public SWriterStage
@@ -44,8 +67,56 @@ public:
     typedef enum
     {
         EVT_WRITE_BODY_PART = 1,    // from 1 since parent uses 0
+        EVT_WRITE_CONTINUE,         // write a 100 Continue
     } EventType;
 
+    //! What is done when a client is not reading its output fast enough
+    // (ie when the output queued for it goes past the high water mark)
+    typedef enum
+    {
+        SLOW_CONSUMER_BLOCK,        // queue everything and leave it to
+                                    // the producers to hold back
+        SLOW_CONSUMER_DROP_OLDEST,  // drop the oldest droppable messages
+        SLOW_CONSUMER_CONFLATE,     // drop queued droppable messages that
+                                    // a new one with the same key replaces
+        SLOW_CONSUMER_DISCONNECT,   // close the connection
+    } SlowConsumerPolicy;
+
+    //! Counts of zero copy sends
+    struct ZeroCopyStats
+    {
+        //! Sends made with MSG_ZEROCOPY
+        size_t  numSends;
+
+        //! Sends the kernel has finished with
+        size_t  numCompleted;
+
+        //! Completed sends whose data the kernel copied anyway
+        size_t  numCopied;
+
+        //! Large parts sent with a plain copy (zero copy was not available
+        // or was given up on for the connection)
+        size_t  numFallbacks;
+    };
+
+    //! Counts of write calls
+    struct WriteStats
+    {
+        //! Responses written out
+        size_t  numResponses;
+
+        //! Write calls (send, sendmsg or sendfile) made for them
+        size_t  numWrites;
+    };
+
+    //! Default write budgets
+    static const size_t DEFAULT_WRITE_BUDGET_BYTES = 256 * 1024;
+    static const int    DEFAULT_WRITE_BUDGET_MSECS = 10;
+
+    //! Default water marks
+    static const size_t DEFAULT_HIGH_WATER_MARK    = 4 * 1024 * 1024;
+    static const size_t DEFAULT_LOW_WATER_MARK     = 1024 * 1024;
+
 public:
     // Creates a http request writer
     SHttpWriterStage(const SString &name = "HttpWriter", int numThreads = DEFAULT_NUM_THREADS);
@@ -64,6 +135,117 @@ public:
 
     //! Send an event to send out a body part on the wire
     virtual bool SendEvent_WriteBodyPart(SConnection *pConnection, SBodyPart *pBodyPart);
+
+    //! Send an event to tell a client waiting to send a request body that
+    // it can go ahead.  Must only be sent before the response to the
+    // request is started.
+    virtual bool SendEvent_WriteContinue(SConnection *pConnection);
+
+    //! Sets the queued bytes above which a connection is congested and
+    // below which it is not any more
+    void SetWaterMarks(size_t high, size_t low)
+    {
+        assert("Low water mark must be below the high one" && low <= high);
+        highWaterMark   = high;
+        lowWaterMark    = low;
+    }
+
+    //! High water mark
+    inline size_t HighWaterMark() const { return highWaterMark; }
+
+    //! Low water mark
+    inline size_t LowWaterMark() const { return lowWaterMark; }
+
+    //! Sets what is done with slow clients
+    void SetSlowConsumerPolicy(SlowConsumerPolicy policy) { slowConsumerPolicy = policy; }
+
+    //! Gets what is done with slow clients
+    inline SlowConsumerPolicy GetSlowConsumerPolicy() const { return slowConsumerPolicy; }
+
+    //! Sets TCP_NOTSENT_LOWAT on connections (0 leaves the system
+    // default).  A small value keeps unsent data queued here, where it can
+    // still be dropped or conflated, instead of in the kernel.
+    void SetNotSentLowWater(int numBytes) { notSentLowWater = numBytes; }
+
+    //! Sets how much a connection may write (and for how long) in one go
+    // before it has to let others have a turn (0 for no limit)
+    void SetWriteBudget(size_t numBytes, int msecs)
+    {
+        writeBudgetBytes    = numBytes;
+        writeBudgetMsecs    = msecs;
+    }
+
+    //! Bytes a connection may write in one go (0 if not limited)
+    inline size_t WriteBudgetBytes() const { return writeBudgetBytes; }
+
+    //! Milliseconds a connection may write for in one go (0 if not limited)
+    inline int WriteBudgetMsecs() const { return writeBudgetMsecs; }
+
+    //! Sets the size from which raw parts are sent with MSG_ZEROCOPY (0
+    // to never do so).  Zero copy only pays off for large buffers as the
+    // pages have to be pinned and the completion read back.
+    void SetZeroCopyThreshold(size_t numBytes) { zeroCopyThreshold = numBytes; }
+
+    //! Size from which raw parts are sent with MSG_ZEROCOPY (0 if never)
+    inline size_t ZeroCopyThreshold() const { return zeroCopyThreshold; }
+
+    //! Gets the zero copy counts so far
+    inline ZeroCopyStats GetZeroCopyStats() const { return zeroCopyStats; }
+
+    //! Adds to the zero copy counts
+    void CountZeroCopy(size_t numSends, size_t numCompleted, size_t numCopied, size_t numFallbacks);
+
+    //! Gets the write call counts so far
+    inline WriteStats GetWriteStats() const { return writeStats; }
+
+    //! Adds to the write call counts
+    void CountWrites(size_t numResponses, size_t numWrites);
+
+    //! Adds a listener for congestion changes
+    void AddOutboundListener(SOutboundListener *pListener) { listeners.push_back(pListener); }
+
+    //! Tells if the output queued for a connection is past the high water
+    // mark (and has not drained since)
+    bool IsCongested(SConnection *pConnection);
+
+    //! Bytes queued for a connection
+    size_t QueuedBytes(SConnection *pConnection);
+
+    //! Tells the listeners a connection has become congested
+    void NotifyCongested(SConnection *pConnection);
+
+    //! Tells the listeners a connection has drained
+    void NotifyDrained(SConnection *pConnection);
+
+    //! Applies TCP_NOTSENT_LOWAT to a new connection
+    void ConfigureSocket(SConnection *pConnection);
+
+protected:
+    //! Water marks on the bytes queued per connection
+    size_t              highWaterMark;
+    size_t              lowWaterMark;
+
+    //! What is done with slow clients
+    SlowConsumerPolicy  slowConsumerPolicy;
+
+    //! Limits on a connection's turn
+    size_t              writeBudgetBytes;
+    int                 writeBudgetMsecs;
+
+    //! Size from which raw parts are sent with MSG_ZEROCOPY
+    size_t              zeroCopyThreshold;
+
+    //! Zero copy counts
+    ZeroCopyStats       zeroCopyStats;
+
+    //! Write call counts
+    WriteStats          writeStats;
+
+    //! TCP_NOTSENT_LOWAT for connections (0 if not set)
+    int                 notSentLowWater;
+
+    //! Listeners for congestion changes
+    std::list<SOutboundListener *>  listeners;
 };
 
 #endif
@@ -38,8 +38,13 @@
 #include <sstream>
 #include <iostream>
 
+//! Initial size of a connection's read buffer
 const int MAXBUF = 2048;
 
+//! The read buffer is only grown when a single unconsumed token (eg a long
+// header line) fills it completely, and never beyond this.
+const int MAX_READ_BUFFER = 16384;
+
 // Creates a message reader stage.
 SReaderStage::SReaderStage(const SString &name, int numThreads) : SStage(name, numThreads)
 {
@@ -92,25 +97,17 @@ void SReaderStage::HandleReadRequestEvent(const SEvent &event)
     // "message" has been read...
     while (pConnection->GetState() == SConnection::STATE_READING)
     {
-        if (pConnection->pReadBuffer == NULL)
-        {
-            pConnection->bufferLength   = MAXBUF;
-            pConnection->pReadBuffer    = new char[pConnection->bufferLength];
-            pConnection->pCurrPos       = pConnection->pReadBuffer;
-            pConnection->pBuffEnd       = pConnection->pReadBuffer;
-        }
+        // leave data in the socket till we are resumed
+        if (ReadPaused(pConnection, pReaderState))
+            return ;
 
         if (pConnection->pCurrPos >= pConnection->pBuffEnd)
         {
-            int buffLen = pConnection->ReadData(pConnection->pReadBuffer, MAXBUF);
-            if (buffLen <= 0)
+            if (FillReadBuffer(pConnection) <= 0)
                 return ;
-
-            pConnection->pCurrPos = pConnection->pReadBuffer;
-            pConnection->pBuffEnd = pConnection->pReadBuffer + buffLen;
         }
 
-        void *pRequest = AssembleRequest(pConnection->pCurrPos, pConnection->pBuffEnd, pReaderState);
+        void *pRequest = AssembleRequest(pConnection, pConnection->pCurrPos, pConnection->pBuffEnd, pReaderState);
         if (pRequest != NULL)
         {
             // set data consumed to false to indicate that there may be
@@ -128,6 +125,62 @@ void SReaderStage::HandleReadRequestEvent(const SEvent &event)
             // sends request to be handled by the next stage
             HandleRequest(pConnection, pRequest);
         }
+        else if (pConnection->GetState() == SConnection::STATE_READING &&
+                 pConnection->pCurrPos < pConnection->pBuffEnd &&
+                 !ReadPaused(pConnection, pReaderState))
+        {
+            // the assembler stopped at an incomplete token so keep what
+            // is left and read more in behind it
+            if (FillReadBuffer(pConnection) <= 0)
+                return ;
+        }
     }
 }
 
+//! Reads more data in after any unconsumed bytes in the read buffer.
+//
+// The unconsumed bytes are moved to the front of the buffer first so
+// assemblers only ever see contiguous data.  Returns the number of bytes
+// read or <= 0 if nothing could be read.
+int SReaderStage::FillReadBuffer(SConnection *pConnection)
+{
+    if (pConnection->pReadBuffer == NULL)
+    {
+        pConnection->bufferLength   = MAXBUF;
+        pConnection->pReadBuffer    = new char[pConnection->bufferLength];
+        pConnection->pCurrPos       = pConnection->pReadBuffer;
+        pConnection->pBuffEnd       = pConnection->pReadBuffer;
+    }
+
+    size_t pending = 0;
+    if (pConnection->pCurrPos < pConnection->pBuffEnd)
+        pending = pConnection->pBuffEnd - pConnection->pCurrPos;
+
+    if (pending > 0 && pConnection->pCurrPos > pConnection->pReadBuffer)
+    {
+        memmove(pConnection->pReadBuffer, pConnection->pCurrPos, pending);
+    }
+    else if (pending == pConnection->bufferLength)
+    {
+        if (pConnection->bufferLength >= (size_t)MAX_READ_BUFFER)
+        {
+            SLogger::Get()->Log("ERROR: Read buffer full [%x], closing connection\n", pConnection);
+            pConnection->Server()->SetConnectionState(pConnection, SConnection::STATE_CLOSED);
+            return -1;
+        }
+
+        char *pNewBuffer = new char[pConnection->bufferLength * 2];
+        memcpy(pNewBuffer, pConnection->pReadBuffer, pending);
+        delete [] pConnection->pReadBuffer;
+        pConnection->pReadBuffer    = pNewBuffer;
+        pConnection->bufferLength   *= 2;
+    }
+
+    pConnection->pCurrPos   = pConnection->pReadBuffer;
+    pConnection->pBuffEnd   = pConnection->pReadBuffer + pending;
+
+    int buffLen = pConnection->ReadData(pConnection->pBuffEnd, pConnection->bufferLength - pending);
+    if (buffLen > 0)
+        pConnection->pBuffEnd += buffLen;
+    return buffLen;
+}
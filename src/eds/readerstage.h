@@ -62,11 +62,20 @@ protected:
     //! Does the actual event handling.
     virtual void    HandleEvent(const SEvent &event);
 
-    //! Tries to assemble the request object from a byte buffer
-    virtual void *  AssembleRequest(char *&pStart, char *&pLast, void *pState) { return NULL; }
+    //! Tries to assemble the request object from a byte buffer.
+    // Bytes left unconsumed (between pStart and pLast) when NULL is
+    // returned are kept in the buffer and more data is read in after them.
+    virtual void *  AssembleRequest(SConnection *pConnection, char *&pStart, char *&pLast, void *pState) { return NULL; }
 
     //! Handles the newly assembled request
     virtual bool    HandleRequest(SConnection *pConnection, void *pRequest) { return true; }
+
+    //! Reads more data in after any unconsumed bytes in the read buffer
+    virtual int     FillReadBuffer(SConnection *pConnection);
+
+    //! Tells if reading has been paused (eg till later stages catch up).
+    // Whoever pauses reading must send a read request to resume it.
+    virtual bool    ReadPaused(SConnection *pConnection, void *pState) { return false; }
 };
 
 #endif
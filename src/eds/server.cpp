@@ -307,7 +307,13 @@ int SEvServer::Run()
     // now run the server asynchronously
     while (!Stopped())
     {
-        int nfds = epoll_wait(serverEpollFD, events, MAXEPOLLSIZE, MAXEPOLLTIME);
+        // dont wait if there are writes to get back to
+        bool writesDeferred;
+        {
+            SMutexLock locker(deferredWritesMutex);
+            writesDeferred = !deferredWrites.empty();
+        }
+        int nfds = epoll_wait(serverEpollFD, events, MAXEPOLLSIZE, writesDeferred ? 0 : MAXEPOLLTIME);
 
         if (nfds < 0)
         {
@@ -325,12 +331,23 @@ int SEvServer::Run()
 
         CheckFinishedConnections();
 
+        ResumeDeferredWrites();
+
         for (int n = 0;!Stopped() && n < nfds;n++)
         {
             SConnection *   pConnection = (SConnection *)(events[n].data.ptr);
             int             connSocket  = pConnection == NULL ? serverSocket : pConnection->Socket();
             int             event_flags = events[n].events;
 
+            if ((event_flags & (EPOLLERR | EPOLLHUP)) == EPOLLERR &&
+                    pConnection != NULL && pConnection->ZeroCopyEnabled() &&
+                    pConnection->SocketError() == 0)
+            {
+                // not an error but zero copy completions on the error
+                // queue - the writer picks these up
+                event_flags |= EPOLLOUT;
+            }
+
             if ((event_flags & (EPOLLERR | EPOLLHUP)) &&
                     (event_flags & (EPOLLIN | EPOLLOUT)) == 0)
             {
@@ -464,11 +481,61 @@ void SEvServer::CloseConnections(int which)
             TConnectionSet::iterator iter = connections[which].begin();
             SConnection *pConnection = *iter;
             connections[which].erase(iter);
+            {
+                SMutexLock deferredLocker(deferredWritesMutex);
+                deferredWrites.erase(pConnection);
+            }
             delete pConnection;
         }
     }
 }
 
+/**************************************************************************************
+*   \brief  Has the writer resume writing to a connection on the next pass
+*   of the event loop.
+*
+*   Edge triggered polling only reports a socket as writable again after
+*   it has been filled, so a writer that stops early (to give other
+*   connections a turn) has to be brought back explicitly.  Doing it from
+*   the event loop instead of queueing an event straight away lets the
+*   events of other connections in first even when the writer has no
+*   threads of its own.
+*
+*   \version
+*       - S Panyam  19/10/2026
+*         Created
+**************************************************************************************/
+void SEvServer::ResumeWriteLater(SConnection *pConnection)
+{
+    if (pConnection->GetState() == SConnection::STATE_CLOSED)
+        return ;
+
+    SMutexLock locker(deferredWritesMutex);
+    deferredWrites.insert(pConnection);
+}
+
+/**************************************************************************************
+*   \brief  Resumes the writes put off with ResumeWriteLater.
+*
+*   \version
+*       - S Panyam  19/10/2026
+*         Created
+**************************************************************************************/
+void SEvServer::ResumeDeferredWrites()
+{
+    TConnectionSet toResume;
+    {
+        SMutexLock locker(deferredWritesMutex);
+        toResume.swap(deferredWrites);
+    }
+
+    for (TConnectionSet::iterator iter = toResume.begin();iter != toResume.end();++iter)
+    {
+        if ((*iter)->GetState() != SConnection::STATE_CLOSED)
+            pWriterStage->SendEvent_ResumeWrite(*iter);
+    }
+}
+
 /**************************************************************************************
 *   \brief  Closes all connections - marked or not.
 *
@@ -109,7 +109,14 @@ public:
     //! Set the new state of a connection
     void        SetConnectionState(SConnection *pConnection, int newState);
 
+    //! Has the writer resume writing to a connection on the next pass of
+    // the event loop (eg after it gave up its turn to other connections)
+    void        ResumeWriteLater(SConnection *pConnection);
+
 protected:
+    //! Resumes the writes put off with ResumeWriteLater
+    void        ResumeDeferredWrites();
+
     // Called to stop the task.
     virtual int RealStop();
 
@@ -159,6 +166,12 @@ private:
 
     //! Mutex on the connection list
     SMutex                      connListMutex;
+
+    //! Connections whose writes are to be resumed
+    TConnectionSet              deferredWrites;
+
+    //! Mutex on the deferred writes
+    SMutex                      deferredWritesMutex;
 };
 
 #endif
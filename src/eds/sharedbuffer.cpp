@@ -0,0 +1,53 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   sharedbuffer.cpp
+ *
+ *  \brief  Immutable reference counted byte buffers.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include "sharedbuffer.h"
+
+#include <new>
+
+//! Creates a buffer with a copy of the given bytes and one reference
+SSharedBuffer *SSharedBuffer::Create(const char *pData, size_t size)
+{
+    void *pMemory = malloc(sizeof(SSharedBuffer) + size);
+    if (pMemory == NULL)
+        throw std::bad_alloc();
+
+    SSharedBuffer *pBuffer = new (pMemory) SSharedBuffer(size);
+    if (size > 0)
+        memcpy((char *)(pBuffer + 1), pData, size);
+    return pBuffer;
+}
+
+//! Drops a reference, freeing the buffer with the last one
+void SSharedBuffer::DecRef()
+{
+    if (__sync_sub_and_fetch(&refCount, 1) == 0)
+    {
+        this->~SSharedBuffer();
+        free(this);
+    }
+}
+
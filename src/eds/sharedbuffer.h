@@ -0,0 +1,85 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   sharedbuffer.h
+ *
+ *  \brief  Immutable reference counted byte buffers.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#ifndef _SSHARED_BUFFER_H_
+#define _SSHARED_BUFFER_H_
+
+#include "fwd.h"
+
+//*****************************************************************************
+/*!
+ *  \class  SSharedBuffer
+ *
+ *  \brief  A block of bytes that never changes once created and is freed
+ *  when the last reference to it is dropped.
+ *
+ *  Buffers are referenced by body parts of different connections that are
+ *  written (and deleted) by different threads, so the count is updated
+ *  atomically.  The bytes live in the same allocation as the count.
+ *
+ *****************************************************************************/
+class SSharedBuffer
+{
+public:
+    //! Creates a buffer with a copy of the given bytes and one reference
+    static SSharedBuffer *Create(const char *pData, size_t size);
+
+    //! Creates a buffer with a copy of a string and one reference
+    static SSharedBuffer *Create(const SString &data) { return Create(data.c_str(), data.size()); }
+
+    //! Adds a reference
+    inline void IncRef() { __sync_add_and_fetch(&refCount, 1); }
+
+    //! Drops a reference, freeing the buffer with the last one
+    void DecRef();
+
+    //! Gets the bytes
+    inline const char *Data() const { return (const char *)(this + 1); }
+
+    //! Gets the number of bytes
+    inline size_t Size() const { return size; }
+
+    //! Gets the current number of references
+    inline unsigned RefCount() const { return refCount; }
+
+private:
+    //! Only created by Create
+    SSharedBuffer(size_t sz) : refCount(1), size(sz) { }
+
+    //! Not copyable
+    SSharedBuffer(const SSharedBuffer &);
+    SSharedBuffer &operator=(const SSharedBuffer &);
+
+private:
+    //! Number of references
+    volatile unsigned   refCount;
+
+    //! Number of bytes that follow
+    size_t              size;
+};
+
+#endif
+
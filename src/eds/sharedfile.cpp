@@ -0,0 +1,58 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   sharedfile.cpp
+ *
+ *  \brief  Reference counted read only file descriptors.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include "utils.h"
+#include "sharedfile.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//! Opens a file with one reference
+SSharedFile *SSharedFile::Open(const SString &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        SLogger::Get()->Log("ERROR: Could not open file: %s, Error [%d]: %s\n",
+                            path.c_str(), errno, strerror(errno));
+        return NULL;
+    }
+    return new SSharedFile(fd);
+}
+
+//! Closes the file
+SSharedFile::~SSharedFile()
+{
+    close(fd);
+}
+
+//! Drops a reference, closing the file with the last one
+void SSharedFile::DecRef()
+{
+    if (__sync_sub_and_fetch(&refCount, 1) == 0)
+        delete this;
+}
+
@@ -0,0 +1,79 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   sharedfile.h
+ *
+ *  \brief  Reference counted read only file descriptors.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#ifndef _SSHARED_FILE_H_
+#define _SSHARED_FILE_H_
+
+#include "fwd.h"
+
+//*****************************************************************************
+/*!
+ *  \class  SSharedFile
+ *
+ *  \brief  A file opened for reading that is closed when the last
+ *  reference to it is dropped.
+ *
+ *  Parts of different responses (written by different threads) can send
+ *  from the same descriptor as sendfile and pread are given the offset to
+ *  read from and never move the file position.
+ *
+ *****************************************************************************/
+class SSharedFile
+{
+public:
+    //! Opens a file with one reference (NULL if it cannot be opened)
+    static SSharedFile *Open(const SString &path);
+
+    //! Adds a reference
+    inline void IncRef() { __sync_add_and_fetch(&refCount, 1); }
+
+    //! Drops a reference, closing the file with the last one
+    void DecRef();
+
+    //! Gets the descriptor
+    inline int FD() const { return fd; }
+
+private:
+    //! Only created by Open
+    SSharedFile(int fileFD) : refCount(1), fd(fileFD) { }
+
+    //! Closes the file
+    ~SSharedFile();
+
+    //! Not copyable
+    SSharedFile(const SSharedFile &);
+    SSharedFile &operator=(const SSharedFile &);
+
+private:
+    //! Number of references
+    volatile unsigned   refCount;
+
+    //! The open file
+    int                 fd;
+};
+
+#endif
+
@@ -38,6 +38,7 @@
 #include "eds/writerstage.h"
 #include "eds/http/bayeux/bayeuxmodule.h"
 #include "eds/http/bayeux/channel.h"
+#include "eds/http/bundlemodule.h"
 #include "eds/http/contentmodule.h"
 #include "eds/http/filemodule.h"
 #include "eds/http/handlerstage.h"
@@ -45,6 +46,7 @@
 #include "eds/http/httpfwd.h"
 #include "eds/http/httpmodule.h"
 #include "eds/http/message.h"
+#include "eds/http/parser.h"
 #include "eds/http/readerstage.h"
 #include "eds/http/request.h"
 #include "eds/http/response.h"
@@ -68,6 +70,7 @@
 #include "utils/refcount.h"
 #include "utils/dirutils.h"
 #include "utils/mimetypes.h"
+#include "utils/strref.h"
 #include "utils/urlutils.h"
 
 #endif
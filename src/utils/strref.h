@@ -0,0 +1,108 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   strref.h
+ *
+ *  \brief  A non-owning reference to a range of characters.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#ifndef _SSTRING_REF_H_
+#define _SSTRING_REF_H_
+
+#include <string>
+#include <string.h>
+#include <strings.h>
+
+//*****************************************************************************
+/*!
+ *  \class  SStringRef
+ *
+ *  \brief  Points into a buffer owned by someone else (usually a
+ *  connection's read buffer).  Only valid as long as the underlying buffer
+ *  is not modified or moved, so copy it out with Str() if it has to be
+ *  kept around.
+ *
+ *****************************************************************************/
+class SStringRef
+{
+public:
+    //! Creates an empty reference
+    SStringRef() : pData(NULL), length(0) { }
+
+    //! Creates a reference to a range of bytes
+    SStringRef(const char *data, size_t len) : pData(data), length(len) { }
+
+    //! Creates a reference to a null terminated string
+    SStringRef(const char *data) : pData(data), length(data ? strlen(data) : 0) { }
+
+    //! Creates a reference to a string's contents
+    SStringRef(const std::string &str) : pData(str.c_str()), length(str.size()) { }
+
+    //! Start of the referenced bytes
+    inline const char *Data() const { return pData; }
+
+    //! One past the last referenced byte
+    inline const char *End() const { return pData + length; }
+
+    //! Number of bytes referenced
+    inline size_t Size() const { return length; }
+
+    //! Tells if nothing is referenced
+    inline bool Empty() const { return length == 0; }
+
+    //! Returns the byte at a given index
+    inline char operator[](size_t index) const { return pData[index]; }
+
+    //! Copies the referenced bytes into a string
+    inline std::string Str() const { return std::string(pData, length); }
+
+    //! Case sensitive comparison
+    inline bool Equals(const SStringRef &other) const
+    {
+        return length == other.length && memcmp(pData, other.pData, length) == 0;
+    }
+
+    //! Case insensitive comparison
+    inline bool EqualsIgnoreCase(const SStringRef &other) const
+    {
+        return length == other.length && strncasecmp(pData, other.pData, length) == 0;
+    }
+
+    //! Returns a reference with leading and trailing whitespace removed
+    inline SStringRef Trim() const
+    {
+        const char *pStart  = pData;
+        const char *pEnd    = pData + length;
+        while (pStart < pEnd && (*pStart == ' ' || *pStart == '\t')) pStart++;
+        while (pEnd > pStart && (pEnd[-1] == ' ' || pEnd[-1] == '\t')) pEnd--;
+        return SStringRef(pStart, pEnd - pStart);
+    }
+
+private:
+    //! Start of the range
+    const char *    pData;
+
+    //! Length of the range
+    size_t          length;
+};
+
+#endif
+
@@ -68,40 +68,45 @@ char hex2dec(char ch)
 
 std::string URLUtils::Unescape(const std::string &str)
 {
-    const char *buff    = str.c_str();
-    const char *pStart  = buff;
-    const char *pEnd    = pStart + str.size();
-    std::stringstream out;
+    std::string out;
+    Unescape(str.c_str(), str.size(), out);
+    return out;
+}
+
+// Appends the unescaped form of [pStart, pStart + length) to out.  Runs
+// between escapes are found with memchr and copied in one go.
+void URLUtils::Unescape(const char *pStart, size_t length, std::string &out)
+{
+    const char *pEnd    = pStart + length;
 
+    out.reserve(out.size() + length);
     while (pStart < pEnd)
     {
-        const char *pos = strchr(pStart, '%');
+        const char *pos = (const char *)memchr(pStart, '%', pEnd - pStart);
         if (pos == NULL)
         {
-            out << pStart;
+            out.append(pStart, pEnd - pStart);
             pStart = pEnd;
         }
         else
         {
-            out << std::string(pStart, pos - pStart);
+            out.append(pStart, pos - pStart);
 
             pStart = pos;
             // skip the '%'
-            if (isxdigit(pStart[1]) && isxdigit(pStart[2]))
+            if (pStart + 2 < pEnd && isxdigit(pStart[1]) && isxdigit(pStart[2]))
             {
                 char ch = (hex2dec(pStart[1]) * 16) + hex2dec(pStart[2]);
-                out << ch;
+                out += ch;
                 pStart += 3;
             }
             else
             {
-                out << *pStart;
+                out += *pStart;
                 pStart++;
             }
         }
     }
-
-    return out.str();
 }
 
 // Reads a line till the CRLF
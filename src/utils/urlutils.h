@@ -50,6 +50,7 @@ public:
     static std::string base64_decode(std::string const& s);
     static std::string Escape(const std::string &);
     static std::string Unescape(const std::string &);
+    static void Unescape(const char *pStart, size_t length, std::string &out);
     static bool ExtractNextQuery(const char *&queryString, std::string &qName, std::string &qValue);
 };
 
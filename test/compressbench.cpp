@@ -0,0 +1,192 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   compressbench.cpp
+ *
+ *  \brief  Measures gzip throughput and ratio against compression level
+ *  with the compression module's zlib settings.
+ *
+ *  Usage: compressbench [-n passes] [-p part size] [-s] [files...]
+ *
+ *  Each file is a response.  As in SCompressionModule, one stream is
+ *  reset between responses (and only initialised again when the level
+ *  changes), the body is fed in parts of the given size (0 for the whole
+ *  file in one part) and the output is collected in 16K parts.  With -s
+ *  every part is sync flushed, as for streamed responses.  The files
+ *  default to the demo html and js pages, so run it from the test
+ *  directory.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <zlib.h>
+#include "eds/http/compressmodule.h"
+
+static int      numPasses       = 200;
+static size_t   partSize        = 0;
+static bool     flushEachPart   = false;
+
+//! Size of the compressed parts (as in the compression module)
+static const size_t COMPRESSED_PART_SIZE = 16 * 1024;
+
+//! The demo pages compressed when no files are given
+static const char *DEFAULT_FILES[] =
+{
+    "index.html",
+    "json.js",
+    "jsonerror.js",
+    "test.js",
+    "microscape/microscape.html",
+    "microscape/m.d.html"
+};
+
+//! Current time in microseconds
+static long long Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+//! Reads a whole file, returning false if it could not be read
+static bool ReadFile(const char *filename, SString &contents)
+{
+    std::ifstream input(filename, std::ios::in | std::ios::binary);
+    if (!input)
+        return false;
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+//! Compresses one response, returning the compressed size
+static size_t CompressResponse(z_stream *pStream, const SString &body, std::vector<char> &output)
+{
+    size_t  compressedSize  = 0;
+    size_t  offset          = 0;
+    size_t  step            = partSize == 0 ? body.size() : partSize;
+    deflateReset(pStream);
+    do
+    {
+        size_t  length  = std::min(step, body.size() - offset);
+        int     flush   = offset + length >= body.size() ? Z_FINISH :
+                                (flushEachPart ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+        pStream->next_in    = (Bytef *)(body.c_str() + offset);
+        pStream->avail_in   = length;
+        do
+        {
+            pStream->next_out   = (Bytef *)&output[0];
+            pStream->avail_out  = output.size();
+            deflate(pStream, flush);
+            compressedSize     += output.size() - pStream->avail_out;
+        } while (pStream->avail_out == 0);
+        offset += length;
+    } while (offset < body.size());
+    return compressedSize;
+}
+
+//! Compresses every file at a level and prints the throughput and ratio
+static bool RunLevel(int level, int windowBits, int memLevel, const std::vector<SString> &bodies)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, windowBits + 16, memLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        fprintf(stderr, "deflateInit2 failed for level %d\n", level);
+        return false;
+    }
+
+    std::vector<char>   output(COMPRESSED_PART_SIZE);
+    size_t              inputSize   = 0;
+    size_t              outputSize  = 0;
+    long long           start       = Now();
+    for (int pass = 0;pass < numPasses;pass++)
+    {
+        for (size_t i = 0;i < bodies.size();i++)
+        {
+            inputSize  += bodies[i].size();
+            outputSize += CompressResponse(&stream, bodies[i], output);
+        }
+    }
+    long long elapsed = Now() - start;
+    deflateEnd(&stream);
+
+    printf("level %d %8.1f MB/s  ratio %5.2f\n", level,
+           inputSize / (double)elapsed, inputSize / (double)outputSize);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:s")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': numPasses     = atoi(optarg); break ;
+            case 'p': partSize      = atoi(optarg); break ;
+            case 's': flushEachPart = true;         break ;
+            default:
+                fprintf(stderr, "Usage: %s [-n passes] [-p part size] [-s] [files...]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (numPasses <= 0)
+        return 1;
+
+    std::vector<const char *> filenames(argv + optind, argv + argc);
+    if (optind == argc)
+        filenames.assign(DEFAULT_FILES, DEFAULT_FILES + sizeof(DEFAULT_FILES) / sizeof(DEFAULT_FILES[0]));
+
+    std::vector<SString>    bodies;
+    size_t                  totalSize   = 0;
+    for (size_t i = 0;i < filenames.size();i++)
+    {
+        SString body;
+        if (!ReadFile(filenames[i], body) || body.empty())
+        {
+            fprintf(stderr, "Could not read %s\n", filenames[i]);
+            return 1;
+        }
+        totalSize += body.size();
+        bodies.push_back(body);
+    }
+
+    // take the zlib settings from a module left at its defaults
+    SCompressionModule module(NULL);
+    printf("%zu files, %zu bytes, %d passes, window %d, memLevel %d, %s\n",
+           bodies.size(), totalSize, numPasses, module.WindowBits(), module.MemLevel(),
+           partSize == 0 ? "whole files" : "in parts");
+    for (int level = 1;level <= 9;level++)
+    {
+        if (!RunLevel(level, module.WindowBits(), module.MemLevel(), bodies))
+            return 1;
+    }
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include "eds/server.h"
 #include "eds/connection.h"
 #include "eds/stage.h"
+#include "eds/sharedbuffer.h"
 #include "eds/http/request.h"
 #include "eds/http/response.h"
 #include "eds/http/readerstage.h"
@@ -12,10 +13,12 @@
 #include "eds/http/writerstage.h"
 #include "eds/http/urlrouter.h"
 #include "eds/http/filemodule.h"
+#include "eds/http/bundlemodule.h"
 #include "eds/http/bayeux/bayeuxmodule.h"
 #include "eds/http/bayeux/channel.h"
 #include "eds/http/contentmodule.h"
 #include "eds/http/transfermodule.h"
+#include "eds/http/compressmodule.h"
 #include "net/connhandler.h"
 #include "net/connfactory.h"
 #include "net/server.h"
@@ -27,13 +30,102 @@ class SMyModule : public SHttpModule
 {
 public:
     // Constructor
-    SMyModule(SHttpModule *pNext) : SHttpModule(pNext) { }
+    SMyModule(SHttpModule *pNext) : SHttpModule(pNext), pFileCache(NULL) { }
 
     //! Called to handle input data from another module
     virtual void ProcessInput(SConnection *         pConnection,
                               SHttpHandlerData *    pHandlerData,
                               SHttpHandlerStage *    pStage,
                               SBodyPart *            pBodyPart);
+
+    //! Sets the file cache whose counts are shown
+    void SetFileCache(SFileCache *pCache) { pFileCache = pCache; }
+
+protected:
+    SFileCache *pFileCache;
+};
+
+// counts the bytes in uploads as they are streamed in
+class SUploadModule : public SHttpModule
+{
+public:
+    // Constructor
+    SUploadModule(SHttpModule *pNext) : SHttpModule(pNext) { }
+
+    //! We want request bodies streamed to us
+    virtual SHttpModule *RequestBodyModule(SHttpRequest *pRequest) { return this; }
+
+    //! Turns away clients waiting to send uploads that are too large
+    virtual bool AcceptRequestBody(SHttpRequest *pRequest) { return pRequest->ContentLength() <= 512 * 1024; }
+
+    //! Called to handle input data from another module
+    virtual void ProcessInput(SConnection *         pConnection,
+                              SHttpHandlerData *    pHandlerData,
+                              SHttpHandlerStage *    pStage,
+                              SBodyPart *            pBodyPart);
+
+    //! Creates the per request byte counter
+    virtual SHttpModuleData *CreateModuleData(SHttpHandlerData *pHandlerData);
+
+protected:
+    //! Sends back the number of bytes uploaded
+    void SendResult(SConnection *pConnection, SHttpHandlerStage *pStage, SHttpResponse *pResponse, size_t numBytes);
+};
+
+// generates the rows of a csv export only as the client reads them
+class SCsvProducer : public SBodyProducer
+{
+public:
+    SCsvProducer(int rows) : numRows(rows), nextRow(-1), lineLength(0), lineOffset(0) { }
+
+    //! Fills the buffer with as many rows as fit
+    virtual int Produce(char *buffer, int maxBytes)
+    {
+        int numBytes = 0;
+        while (numBytes < maxBytes)
+        {
+            if (lineOffset == lineLength)
+            {
+                if (nextRow >= numRows)
+                    break ;
+                if (nextRow < 0)
+                    lineLength = snprintf(line, sizeof(line), "id,name,square\r\n");
+                else
+                    lineLength = snprintf(line, sizeof(line), "%d,row %d,%lld\r\n",
+                                          nextRow, nextRow, (long long)nextRow * nextRow);
+                lineOffset = 0;
+                nextRow++;
+            }
+            int length = std::min(lineLength - lineOffset, maxBytes - numBytes);
+            memcpy(buffer + numBytes, line + lineOffset, length);
+            lineOffset  += length;
+            numBytes    += length;
+        }
+        return numBytes;
+    }
+
+protected:
+    int     numRows;
+    int     nextRow;
+    char    line[64];
+    int     lineLength;
+    int     lineOffset;
+};
+
+// publishes whatever is sent to it to all its subscribers
+class SEchoChannel : public SBayeuxChannel
+{
+public:
+    //! Constructor
+    SEchoChannel(SBayeuxModule *pMod, const std::string &name) : SBayeuxChannel(name, pMod) { }
+
+    void HandleEvent(const JsonNodePtr &message, JsonNodePtr &output)
+    {
+        JsonNodePtr data = message->Get("data");
+        if (!data)
+            data = JsonNodeFactory::StringNode("");
+        pModule->DeliverEvent(this, data);
+    }
 };
 
 class MyBayeuxChannel : public virtual SBayeuxChannel, public virtual SServer
@@ -89,34 +181,48 @@ public:
     SHttpReaderStage    requestReader;
     SHttpWriterStage    requestWriter;
     SHttpHandlerStage   requestHandler;
-    // STransferModule     transferModule(&writerModule);
+    STransferModule     transferModule;
     SContentModule      contentModule;
+    SCompressionModule  compressModule;
     SBayeuxModule       bayeuxModule;
+    SEchoChannel        echoChannel;
+    SFileCache          fileCache;
     SFileModule         rootFileModule;
     SMyModule           myModule;
+    SUploadModule       uploadModule;
     SFileModule         testModule;
+    SBundleModule       bundleModule;
     SUrlRouter          urlRouter;
     SContainsUrlMatcher microscapeUrlMatch;
     SContainsUrlMatcher staticUrlMatch;
     SContainsUrlMatcher testUrlMatch;
     SContainsUrlMatcher dsUrlMatch;
+    SContainsUrlMatcher uploadUrlMatch;
+    SContainsUrlMatcher bundleUrlMatch;
     SEvServer           pServer;
 
 public:
-    ServerContext(int port = 80)    :
+    ServerContext(int port = 80, SAssetBundle *pBundle = NULL)    :
         requestReader("Reader", 0),
         requestWriter("Writer", 0),
         requestHandler("Handler", 0),
-        contentModule(NULL),
+        transferModule(NULL),
+        contentModule(&transferModule),
+        compressModule(&contentModule),
         bayeuxModule(&contentModule, "MyTestBoundary"),
-        rootFileModule(&contentModule, true),
-        myModule(&contentModule),
-        testModule(&contentModule, true),
+        echoChannel(&bayeuxModule, "/echo"),
+        rootFileModule(&compressModule, true),
+        myModule(&compressModule),
+        uploadModule(&contentModule),
+        testModule(&compressModule, true),
+        bundleModule(&compressModule, pBundle),
         urlRouter(&myModule),
         microscapeUrlMatch("/microscape/", SContainsUrlMatcher::PREFIX_MATCH, &rootFileModule),
         staticUrlMatch("/static/", SContainsUrlMatcher::PREFIX_MATCH, &rootFileModule),
         testUrlMatch("/btest/", SContainsUrlMatcher::PREFIX_MATCH, &testModule),
         dsUrlMatch("/bayeux/", SContainsUrlMatcher::PREFIX_MATCH, &bayeuxModule),
+        uploadUrlMatch("/upload/", SContainsUrlMatcher::PREFIX_MATCH, &uploadModule),
+        bundleUrlMatch("/bundle/", SContainsUrlMatcher::PREFIX_MATCH, &bundleModule),
         pServer(port, &requestReader, &requestWriter)
     {
         testModule.AddDocRoot("/btest/", "./test/");
@@ -125,17 +231,42 @@ public:
         // rootFileModule.AddDocRoot("/microscape/", "/home/sri/sandbox/cpp/halley/trunk/test/microscape/");
         rootFileModule.AddDocRoot("/static/", "/");
 
+        // a packed docroot (see halleypack) if one was given
+        bundleModule.AddDocRoot("/bundle/", "/");
+
+        // both file modules look files up in the same cache
+        rootFileModule.SetFileCache(&fileCache);
+        testModule.SetFileCache(&fileCache);
+        myModule.SetFileCache(&fileCache);
+
+        // small files are kept in memory
+        fileCache.SetContentLimits(64 * 1024, 8 * 1024 * 1024);
+
+        bayeuxModule.RegisterChannel(&echoChannel);
+
         urlRouter.AddUrlMatch(&microscapeUrlMatch);
         urlRouter.AddUrlMatch(&staticUrlMatch);
         urlRouter.AddUrlMatch(&testUrlMatch);
         urlRouter.AddUrlMatch(&dsUrlMatch);
+        urlRouter.AddUrlMatch(&uploadUrlMatch);
+        urlRouter.AddUrlMatch(&bundleUrlMatch);
 
         requestReader.SetHandlerStage(&requestHandler);
+        requestReader.SetMaxBodySize(1024 * 1024);
+        requestReader.SetSpoolThreshold(64 * 1024);
 
         requestHandler.SetRootModule(&urlRouter);
         requestHandler.SetReaderStage(&requestReader);
         requestHandler.SetWriterStage(&requestWriter);
 
+        // clients that fall behind only get the latest event per channel
+        requestWriter.SetWaterMarks(256 * 1024, 64 * 1024);
+        requestWriter.SetSlowConsumerPolicy(SHttpWriterStage::SLOW_CONSUMER_CONFLATE);
+        requestWriter.SetNotSentLowWater(64 * 1024);
+
+        // large snapshots go out without being copied into the kernel
+        requestWriter.SetZeroCopyThreshold(64 * 1024);
+
         pServer.SetStage("RequestReader", &requestReader);
         pServer.SetStage("RequestHandler", &requestHandler);
         pServer.SetStage("RequestWriter", &requestWriter);
@@ -202,7 +333,13 @@ int main(int argc, char *argv[])
     SLogger::Add(&ourLogger);
 
     int port = argc <= 1 ? 80 : atoi(argv[1]);
-    serverContext = new ServerContext(port);
+
+    // halley [port] [asset bundle]
+    SAssetBundle *pBundle = NULL;
+    if (argc > 2 && (pBundle = SAssetBundle::Open(argv[2])) != NULL)
+        cerr << "Serving " << pBundle->NumEntries() << " files from " << argv[2] << " under /bundle/" << endl;
+
+    serverContext = new ServerContext(port, pBundle);
     cerr << "Server Started on port: " << port << "..." << endl;
     serverContext->pServer.Start();
     cerr << "Server Finished..." << endl;
@@ -228,6 +365,10 @@ void SMyModule::ProcessInput(SConnection *          pConnection,
             "<br><a href='/form'>form</a> "
             "<br><a href='/auth'>authentication example</a> [use <b>adp</b> as username and <b>gmbh</b> as password"
             "<br><a href='/header'>show some HTTP header details</a> "
+            "<br><a href='/stream'>a response streamed in chunks</a> "
+            "<br><a href='/export.csv'>a large csv export generated as it is sent</a> "
+            "<br><a href='/snapshot'>a large json snapshot sent with zero copy</a> "
+            "<br><a href='/cachestats'>file cache counts</a> "
             "<br><a href='/btest/'>Bayeux Test</a> "
             ;
 
@@ -256,12 +397,90 @@ void SMyModule::ProcessInput(SConnection *          pConnection,
                             "<tr><td>Field 3</td><td><input name=field_3></td></tr>"
                             "</table>"
                             "<input type=submit></form>";
+
+        // show what was submitted last time
+        const char *fields[] = { "field_1", "field_2", "field_3" };
+        for (int i = 0;i < 3;i++)
+        {
+            SString value;
+            if (pRequest->GetQueryValue(fields[i], value))
+                body += SString("<br>") + fields[i] + " = " + value;
+        }
         body += "<hr>" + links;
     }
+    else if (pRequest->Resource() == "/stream") {
+        // the length is not known upfront so send it in chunks
+        pResponse->Headers().SetHeader(HDR_TRANSFER_ENCODING, "chunked");
+        // the heading markup is shared by all the parts instead of copied
+        static SSharedBuffer *pHeadingStart = SSharedBuffer::Create("<h1 style='color: ");
+        static SSharedBuffer *pHeadingEnd   = SSharedBuffer::Create("'>Part</h1>");
+        const char *colors[] = { "#ff4444", "#44ff44", "#4444ff" };
+        for (int i = 0;i < 3;i++)
+        {
+            SSegmentedBodyPart *part = pResponse->NewSegmentedBodyPart(pNextModule);
+            part->Append(pHeadingStart);
+            part->Append(colors[i], strlen(colors[i]));
+            part->Append(pHeadingEnd);
+            if (i == 0)
+                part->Prepend("<html><head><title>Streamed</title></head><body>");
+            if (i == 2)
+                part->Append(links + "</body></html>");
+            pStage->SendEvent_OutputToModule(pConnection, pNextModule, part);
+        }
+        pStage->SendEvent_OutputToModule(pConnection, pNextModule,
+                               pResponse->NewContFinishedPart(pNextModule));
+        return ;
+    }
+    else if (pRequest->Resource() == "/export.csv") {
+        // the rows are pulled by the writer as the socket drains
+        SString rows;
+        int numRows = pRequest->GetQueryValue("rows", rows) ? atoi(rows.c_str()) : 100000;
+        pResponse->Headers().SetHeader(HDR_CONTENT_TYPE, "text/csv");
+        pStage->SendEvent_OutputToModule(pConnection, pNextModule,
+                               pResponse->NewLazyBodyPart(new SCsvProducer(numRows), pNextModule));
+        pStage->SendEvent_OutputToModule(pConnection, pNextModule,
+                               pResponse->NewContFinishedPart(pNextModule));
+        return ;
+    }
+    else if (pRequest->Resource() == "/snapshot") {
+        // one big body built in memory
+        SString size;
+        int numBytes = pRequest->GetQueryValue("size", size) ? atoi(size.c_str()) : 1024 * 1024;
+        SRawBodyPart *part = pResponse->NewRawBodyPart(pNextModule);
+        part->SetBody("[");
+        char entry[64];
+        for (int i = 0;part->Size() < numBytes;i++)
+        {
+            int length = snprintf(entry, sizeof(entry), "%s{\"id\": %d, \"value\": %d}", i == 0 ? "" : ",", i, (i * 7919) % 10007);
+            part->AppendToBody(entry, length);
+        }
+        part->AppendToBody("]");
+        pResponse->Headers().SetHeader(HDR_CONTENT_TYPE, "application/json");
+        pStage->SendEvent_OutputToModule(pConnection, pNextModule, part);
+        pStage->SendEvent_OutputToModule(pConnection, pNextModule,
+                               pResponse->NewContFinishedPart(pNextModule));
+        return ;
+    }
+    else if (pRequest->Resource() == "/cachestats" && pFileCache != NULL) {
+        SFileCache::Stats stats = pFileCache->GetStats();
+        size_t numLookups = stats.numHits + stats.numMisses;
+        char counts[512];
+        snprintf(counts, sizeof(counts),
+                 "<h1>File Cache</h1>"
+                 "<br>hits: %zu, misses: %zu, hit rate: %.1f%%"
+                 "<br>hits served from memory: %zu, bytes in memory: %zu"
+                 "<br>invalidated: %zu, evicted: %zu",
+                 stats.numHits, stats.numMisses,
+                 numLookups == 0 ? 0.0 : stats.numHits * 100.0 / numLookups,
+                 stats.numContentHits, stats.contentBytes,
+                 stats.numInvalidated, stats.numEvicted);
+        title   = "File Cache";
+        body    = counts + links;
+    }
     else if (pRequest->Resource() == "/header") {
         title    = "HTTP Headers";
         body    = "<h1> Your HTTP Headers</h1>";
-        for (std::map<SString, SString>::const_iterator i = reqHeaders.FirstHeader();
+        for (HeaderList::const_iterator i = reqHeaders.FirstHeader();
                  i != reqHeaders.LastHeader();
                  i++)
         {
@@ -290,3 +509,75 @@ void SMyModule::ProcessInput(SConnection *          pConnection,
                            pResponse->NewContFinishedPart(pNextModule));
 }
 
+// Bytes uploaded so far in a request
+class SUploadData : public SHttpModuleData
+{
+public:
+    SUploadData() : numBytes(0) { }
+
+    virtual void Reset()
+    {
+        SHttpModuleData::Reset();
+        numBytes = 0;
+    }
+
+    size_t numBytes;
+};
+
+//! Creates the per request byte counter
+SHttpModuleData *SUploadModule::CreateModuleData(SHttpHandlerData *pHandlerData)
+{
+    return new SUploadData();
+}
+
+//! Called with the request and then each part of its body
+void SUploadModule::ProcessInput(SConnection *          pConnection,
+                                 SHttpHandlerData *     pHandlerData,
+                                 SHttpHandlerStage *    pStage,
+                                 SBodyPart *            pBodyPart)
+{
+    SHttpRequest *  pRequest    = pHandlerData->Request();
+    SHttpResponse * pResponse   = pRequest->Response();
+    SUploadData *   pModData    = (SUploadData *)pHandlerData->GetModuleData(this, true);
+
+    // an upload that was turned away before it was sent
+    if (pRequest->BodyDeclined())
+    {
+        pResponse->SetStatus(413, "Request Entity Too Large");
+        SendResult(pConnection, pStage, pResponse, 0);
+        return ;
+    }
+
+    // a request without a body (not streamed)
+    if (pBodyPart == NULL && !pRequest->BodyStreamed())
+    {
+        SendResult(pConnection, pStage, pResponse, 0);
+        return ;
+    }
+
+    // parts can arrive out of order so let the module data order them
+    for (SBodyPart *pPart = pModData->PutAndGetBodyPart(pBodyPart);
+            pPart != NULL; pPart = pModData->NextBodyPart())
+    {
+        bool finished = pPart->Type() == SHttpMessage::HTTP_BP_CONTENT_FINISHED;
+        if (!finished)
+            pModData->numBytes += ((SRawBodyPart *)pPart)->Size();
+        pStage->SendEvent_InputConsumed(pConnection, pPart);
+
+        if (finished)
+            SendResult(pConnection, pStage, pResponse, pModData->numBytes);
+    }
+}
+
+//! Sends back the number of bytes uploaded
+void SUploadModule::SendResult(SConnection *pConnection, SHttpHandlerStage *pStage, SHttpResponse *pResponse, size_t numBytes)
+{
+    std::stringstream sstr;
+    sstr << "<html><body>Uploaded " << numBytes << " bytes</body></html>";
+
+    SRawBodyPart *part = pResponse->NewRawBodyPart(pNextModule);
+    part->SetBody(sstr.str());
+    pStage->SendEvent_OutputToModule(pConnection, pNextModule, part);
+    pStage->SendEvent_OutputToModule(pConnection, pNextModule,
+                           pResponse->NewContFinishedPart(pNextModule));
+}
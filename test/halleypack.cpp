@@ -0,0 +1,64 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   halleypack.cpp
+ *
+ *  \brief  Packs a docroot into an asset bundle for SBundleModule.
+ *
+ *  Usage: halleypack <docroot> <archive>
+ *
+ *  .br and .gz files next to a file (and not older than it) are stored as
+ *  its precompressed copies.  An existing archive is replaced atomically
+ *  so it can be repacked while a server has it open.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include <iostream>
+#include "logger/logger.h"
+#include "eds/sharedfile.h"
+#include "eds/http/bundle.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <docroot> <archive>" << std::endl;
+        return 1;
+    }
+
+    SLogger ourLogger;
+    SLogger::Add(&ourLogger);
+
+    if (!SAssetBundle::Pack(argv[1], argv[2]))
+        return 1;
+
+    // check that it reads back
+    SAssetBundle *pBundle = SAssetBundle::Open(argv[2]);
+    if (pBundle == NULL)
+        return 1;
+
+    struct stat archiveStat;
+    fstat(pBundle->File()->FD(), &archiveStat);
+    std::cout << "Packed " << pBundle->NumEntries() << " files into " << argv[2]
+              << " (" << archiveStat.st_size << " bytes)" << std::endl;
+    delete pBundle;
+    return 0;
+}
+
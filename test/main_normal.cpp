@@ -100,7 +100,7 @@ bool MyHandler::ProcessRequest(SHttpRequest &request, SHttpResponse &response)
               "<input type=submit></form>";
 
 
-    for (std::map<std::string, std::string>::const_iterator i = request.FirstHeader();
+    for (HeaderList::const_iterator i = request.FirstHeader();
          i != request.LastHeader();
          i++)
     {
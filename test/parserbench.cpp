@@ -0,0 +1,266 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   parserbench.cpp
+ *
+ *  \brief  Measures how fast request heads are split into tokens.
+ *
+ *  Usage: parserbench [-n iterations] [-c cookie bytes]
+ *
+ *  The head is a browser style GET with a cookie of the given size.
+ *  Each case is run on a reused request like the reader does:
+ *      - stream    the head is read with ReadFromStream from a
+ *                  stringstream (how heads were read before the in place
+ *                  parser)
+ *      - tokens    the head is split with SHttpParser and nothing is kept
+ *      - parser    the head is split with SHttpParser and the tokens are
+ *                  stored like the reader stage does
+ *      - segments  as parser, but the head arrives in 1460 byte reads
+ *                  into a buffer that is compacted and doubled the way
+ *                  the reader stage manages its read buffer
+ *      - scan      FindDelimiter over the head without the line handling
+ *
+ *  Building parser.cpp without __SSE2__ (eg with -U__SSE2__) gives the
+ *  numbers of the scalar scan.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sstream>
+#include "logger/logger.h"
+#include "eds/http/parser.h"
+#include "eds/http/request.h"
+
+//! Drops the per request debug logs so only the parsing is timed
+class SQuietLogger : public SLogger
+{
+public:
+    virtual int Log(const char *fmt, ...) { return 0; }
+};
+
+static int      numIterations   = 200000;
+static size_t   cookieBytes     = 600;
+
+//! Size of each read in the segments case (a typical TCP segment)
+static const size_t SEGMENT_SIZE        = 1460;
+
+//! Initial and largest read buffer sizes (as in the reader stage)
+static const size_t INITIAL_BUFFER_SIZE = 2048;
+static const size_t MAX_BUFFER_SIZE     = 16384;
+
+//! Current time in microseconds
+static long long Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+//! Builds the request head
+static SString MakeHead()
+{
+    SString head("GET /static/js/app.min.js?v=20261019 HTTP/1.1\r\n"
+                 "Host: www.example.com\r\n"
+                 "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+                 "(KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+                 "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+                 "image/avif,image/webp,*/*;q=0.8\r\n"
+                 "Accept-Language: en-US,en;q=0.9\r\n"
+                 "Accept-Encoding: gzip, deflate, br\r\n"
+                 "Referer: https://www.example.com/products/listing?page=2&sort=price\r\n"
+                 "Connection: keep-alive\r\n"
+                 "If-None-Match: \"5f3e-1a2b3c4d\"\r\n"
+                 "Cache-Control: max-age=0\r\n"
+                 "Cookie: ");
+    for (size_t i = 0;head.size() < cookieBytes + 560;i++)
+    {
+        char crumb[32];
+        snprintf(crumb, sizeof(crumb), "%sk%zu=v%08zx", i > 0 ? "; " : "", i, i * 2654435761U);
+        head += crumb;
+    }
+    head += "\r\n\r\n";
+    return head;
+}
+
+//! Splits a head with the parser, storing the tokens if a request is given.
+// Returns false if the head was incomplete or bad.
+static bool ParseHead(SHttpParser &parser, SHttpRequest *pRequest,
+                      const char *&pStart, const char *pLast)
+{
+    while (true)
+    {
+        int token = parser.NextToken(pStart, pLast);
+        if (token <= 0)
+            return false;
+        else if (token == SHttpParser::TOKEN_HEADERS_DONE)
+            return true;
+        else if (pRequest == NULL)
+            continue ;
+        else if (token == SHttpParser::TOKEN_REQUEST_LINE)
+            pRequest->SetRequestLine(parser.method, parser.resource, parser.version);
+        else if (token == SHttpParser::TOKEN_HEADER)
+            pRequest->Headers().SetHeader(parser.name.Str(), parser.value.Str());
+    }
+}
+
+//! Prints the time per head
+static void Report(const char *label, long long elapsed, size_t checksum, size_t headSize)
+{
+    double nsPerHead = elapsed * 1000.0 / numIterations;
+    printf("%-10s %8.0f ns/head %8.2f GB/s (checksum %zu)\n", label, nsPerHead,
+           headSize / nsPerHead, checksum);
+}
+
+//! Reads heads from a stringstream
+static void RunStream(const SString &head)
+{
+    SHttpRequest    request;
+    size_t          checksum    = 0;
+    long long       start       = Now();
+    for (int i = 0;i < numIterations;i++)
+    {
+        std::istringstream input(head);
+        request.Reset();
+        request.ReadFromStream(input);
+        checksum += request.Headers().Header(HDR_COOKIE).size();
+    }
+    Report("stream", Now() - start, checksum, head.size());
+}
+
+//! Splits heads in place
+static void RunParser(const char *label, const SString &head, bool store)
+{
+    SHttpRequest    request;
+    SHttpParser     parser;
+    size_t          checksum    = 0;
+    long long       start       = Now();
+    for (int i = 0;i < numIterations;i++)
+    {
+        const char *pStart = head.c_str();
+        request.Reset();
+        parser.Reset();
+        checksum += ParseHead(parser, store ? &request : NULL, pStart, head.c_str() + head.size());
+        checksum += store ? request.Headers().Header(HDR_COOKIE).size() : 0;
+    }
+    Report(label, Now() - start, checksum, head.size());
+}
+
+//! Splits heads that arrive a segment at a time
+static void RunSegments(const SString &head)
+{
+    SHttpRequest    request;
+    SHttpParser     parser;
+    size_t          checksum    = 0;
+    long long       start       = Now();
+    for (int i = 0;i < numIterations;i++)
+    {
+        size_t      bufferLength    = INITIAL_BUFFER_SIZE;
+        char *      pBuffer         = new char[bufferLength];
+        const char *pStart          = pBuffer;
+        char *      pEnd            = pBuffer;
+        size_t      sent            = 0;
+        bool        done            = false;
+
+        request.Reset();
+        parser.Reset();
+        while (!done && sent < head.size())
+        {
+            // keep the unconsumed bytes at the front and grow when full
+            size_t pending = pEnd - pStart;
+            if (pending > 0 && pStart > pBuffer)
+            {
+                memmove(pBuffer, pStart, pending);
+            }
+            else if (pending == bufferLength)
+            {
+                if (bufferLength >= MAX_BUFFER_SIZE)
+                    break ;
+                char *pNewBuffer = new char[bufferLength * 2];
+                memcpy(pNewBuffer, pBuffer, pending);
+                delete [] pBuffer;
+                pBuffer         = pNewBuffer;
+                bufferLength   *= 2;
+            }
+            pStart  = pBuffer;
+            pEnd    = pBuffer + pending;
+
+            size_t numRead = std::min(std::min(SEGMENT_SIZE, head.size() - sent), bufferLength - pending);
+            memcpy(pEnd, head.c_str() + sent, numRead);
+            pEnd   += numRead;
+            sent   += numRead;
+            done    = ParseHead(parser, &request, pStart, pEnd);
+        }
+        delete [] pBuffer;
+        checksum += done + request.Headers().Header(HDR_COOKIE).size();
+    }
+    Report("segments", Now() - start, checksum, head.size());
+}
+
+//! Scans heads for delimiters only
+static void RunScan(const SString &head)
+{
+    size_t      checksum    = 0;
+    const char *pLast       = head.c_str() + head.size();
+    long long   start       = Now();
+    for (int i = 0;i < numIterations;i++)
+    {
+        for (const char *pCurr = head.c_str();pCurr < pLast;pCurr++)
+        {
+            pCurr = SHttpParser::FindDelimiter(pCurr, pLast, false);
+            checksum++;
+        }
+    }
+    Report("scan", Now() - start, checksum, head.size());
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "n:c:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': numIterations = atoi(optarg); break ;
+            case 'c': cookieBytes   = atoi(optarg); break ;
+            default:
+                fprintf(stderr, "Usage: %s [-n iterations] [-c cookie bytes]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (numIterations <= 0)
+        return 1;
+
+    SQuietLogger ourLogger;
+    SLogger::Add(&ourLogger);
+
+    SString head = MakeHead();
+    printf("%zu byte head, %d iterations\n", head.size(), numIterations);
+
+    RunStream(head);
+    RunParser("tokens", head, false);
+    RunParser("parser", head, true);
+    RunSegments(head);
+    RunScan(head);
+    return 0;
+}
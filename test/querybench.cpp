@@ -0,0 +1,135 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   querybench.cpp
+ *
+ *  \brief  Measures the cost of setting the request line of analytics
+ *  style URLs (with many query params) and looking params up.
+ *
+ *  Usage: querybench [-n iterations] [-p params]
+ *
+ *  Each case is run on a reused request like the reader does:
+ *      - line      the request line is set and nothing is looked up
+ *      - route     the decoded path is fetched (as the router does)
+ *      - lookup3   the path and three of the params are fetched
+ *      - all       the path and every param are fetched
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <vector>
+#include "logger/logger.h"
+#include "utils/strref.h"
+#include "eds/http/request.h"
+
+//! Drops the per request debug logs so only the parsing is timed
+class SQuietLogger : public SLogger
+{
+public:
+    virtual int Log(const char *fmt, ...) { return 0; }
+};
+
+static int  numIterations   = 200000;
+static int  numParams       = 32;
+
+//! Current time in microseconds
+static long long Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+//! Builds a tracking pixel style URL with the given number of params,
+// some of them escaped
+static SString MakeURL(int count, std::vector<SString> &names)
+{
+    SString url("/collect/v1/event%20pixel.gif?");
+    char    param[128];
+    for (int i = 0;i < count;i++)
+    {
+        snprintf(param, sizeof(param), "p%02d_name", i);
+        names.push_back(param);
+        snprintf(param, sizeof(param), "%sp%02d_name=%s%d", i > 0 ? "&" : "", i,
+                 i % 4 == 0 ? "some%20escaped%2Fvalue%3D" : "plainvalue", i * 7919);
+        url += param;
+    }
+    return url;
+}
+
+//! Runs one case and prints the time per request
+static void RunCase(const char *label, const SString &url, const std::vector<SString> &names,
+                    bool route, size_t numLookups)
+{
+    static const char METHOD[]  = "GET";
+    static const char VERSION[] = "HTTP/1.1";
+
+    SHttpRequest    request;
+    size_t          checksum    = 0;
+    long long       start       = Now();
+    for (int i = 0;i < numIterations;i++)
+    {
+        request.Reset();
+        request.SetRequestLine(SStringRef(METHOD, sizeof(METHOD) - 1),
+                               SStringRef(url.c_str(), url.size()),
+                               SStringRef(VERSION, sizeof(VERSION) - 1));
+        if (route)
+            checksum += request.Resource().size();
+        for (size_t j = 0;j < numLookups;j++)
+            checksum += request.GetQueryValue(names[(j * 11) % names.size()]).size();
+    }
+    long long elapsed = Now() - start;
+    printf("%-10s %8.0f ns/request (checksum %zu)\n", label,
+           elapsed * 1000.0 / numIterations, checksum);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': numIterations = atoi(optarg); break ;
+            case 'p': numParams     = atoi(optarg); break ;
+            default:
+                fprintf(stderr, "Usage: %s [-n iterations] [-p params]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (numIterations <= 0 || numParams <= 0)
+        return 1;
+
+    SQuietLogger ourLogger;
+    SLogger::Add(&ourLogger);
+
+    std::vector<SString> names;
+    SString url = MakeURL(numParams, names);
+    printf("%d params, %zu byte URL, %d iterations\n", numParams, url.size(), numIterations);
+
+    RunCase("line", url, names, false, 0);
+    RunCase("route", url, names, true, 0);
+    RunCase("lookup3", url, names, true, 3);
+    RunCase("all", url, names, true, names.size());
+    return 0;
+}
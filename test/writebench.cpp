@@ -0,0 +1,203 @@
+//*****************************************************************************
+/*!
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************
+ *
+ *  \file   writebench.cpp
+ *
+ *  \brief  Measures the latency of small responses while other clients
+ *  download large bodies as fast as they can.
+ *
+ *  Usage: writebench [-h host] [-p port] [-b bulk path] [-n bulk clients]
+ *                    [-s small path] [-c small requests]
+ *
+ *  The small requests are first timed on an idle server and then again
+ *  with the bulk downloads running.
+ *
+ *  \version
+ *      - S Panyam      19/10/2026
+ *        Created
+ *
+ *****************************************************************************/
+
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static std::string  host        = "127.0.0.1";
+static std::string  port        = "8080";
+static std::string  bulkPath    = "/export.csv?rows=10000000";
+static std::string  smallPath   = "/red";
+static int          numBulk     = 4;
+static int          numSmall    = 200;
+
+static volatile bool        stopBulk        = false;
+static volatile long long   bulkBytes       = 0;
+
+//! Current time in microseconds
+static long long Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+//! Connects to the server
+static int Connect()
+{
+    struct addrinfo hints, *pAddr = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family     = AF_INET;
+    hints.ai_socktype   = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &pAddr) != 0)
+        return -1;
+
+    int sock = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+    if (sock >= 0 && connect(sock, pAddr->ai_addr, pAddr->ai_addrlen) != 0)
+    {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(pAddr);
+    return sock;
+}
+
+//! Makes a request and reads the response - till the end of its body if
+// it has a Content-Length or else till the server closes the connection.
+// Returns the number of bytes read (-1 on errors).
+static long long Fetch(const std::string &path, volatile long long *pCounter)
+{
+    int sock = Connect();
+    if (sock < 0)
+        return -1;
+
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n\r\n";
+    if (write(sock, request.c_str(), request.size()) != (ssize_t)request.size())
+    {
+        close(sock);
+        return -1;
+    }
+
+    char        buffer[65536];
+    std::string head;
+    long long   total       = 0;
+    long long   expected    = -1;
+    ssize_t     numRead;
+    while ((expected < 0 || total < expected) &&
+           (numRead = read(sock, buffer, sizeof(buffer))) > 0 && !(pCounter && stopBulk))
+    {
+        total += numRead;
+        if (pCounter)
+            __sync_add_and_fetch(pCounter, (long long)numRead);
+
+        if (expected < 0 && head.size() < 16384)
+        {
+            head.append(buffer, numRead);
+            size_t headEnd = head.find("\r\n\r\n");
+            size_t lengthAt = head.find("Content-Length: ");
+            if (headEnd != std::string::npos && lengthAt != std::string::npos && lengthAt < headEnd)
+                expected = headEnd + 4 + atoll(head.c_str() + lengthAt + 16);
+        }
+    }
+    close(sock);
+    return total;
+}
+
+//! Downloads the bulk path over and over
+static void *BulkClient(void *)
+{
+    while (!stopBulk)
+    {
+        if (Fetch(bulkPath, &bulkBytes) < 0)
+            usleep(10000);
+    }
+    return NULL;
+}
+
+//! Times the small requests and prints the spread
+static void TimeSmallRequests(const char *label)
+{
+    std::vector<long long> latencies;
+    int numFailed = 0;
+    for (int i = 0;i < numSmall;i++)
+    {
+        long long start = Now();
+        if (Fetch(smallPath, NULL) <= 0)
+            numFailed++;
+        else
+            latencies.push_back(Now() - start);
+    }
+
+    if (latencies.empty())
+    {
+        printf("%-12s all %d requests failed\n", label, numFailed);
+        return ;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    size_t n = latencies.size();
+    printf("%-12s requests %zu, failed %d, usecs: min %lld, p50 %lld, p90 %lld, p99 %lld, max %lld\n",
+           label, n, numFailed, latencies[0], latencies[n / 2], latencies[n * 9 / 10],
+           latencies[std::min(n - 1, n * 99 / 100)], latencies[n - 1]);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:b:n:s:c:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'h': host      = optarg; break ;
+            case 'p': port      = optarg; break ;
+            case 'b': bulkPath  = optarg; break ;
+            case 'n': numBulk   = atoi(optarg); break ;
+            case 's': smallPath = optarg; break ;
+            case 'c': numSmall  = atoi(optarg); break ;
+            default:
+                fprintf(stderr, "Usage: %s [-h host] [-p port] [-b bulk path] [-n bulk clients] "
+                                "[-s small path] [-c small requests]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    TimeSmallRequests("idle");
+
+    std::vector<pthread_t> threads(numBulk);
+    for (int i = 0;i < numBulk;i++)
+        pthread_create(&threads[i], NULL, BulkClient, NULL);
+
+    // let the downloads get going
+    usleep(500000);
+
+    long long start = Now();
+    bulkBytes = 0;
+    TimeSmallRequests("bulk");
+    double elapsed = (Now() - start) / 1000000.0;
+    printf("%-12s %d clients, %.1f MB/s\n", "downloads", numBulk, bulkBytes / elapsed / (1024 * 1024));
+
+    stopBulk = true;
+    for (int i = 0;i < numBulk;i++)
+        pthread_join(threads[i], NULL);
+    return 0;
+}
+